@@ -0,0 +1,31 @@
+# Склеивает скомпилированные SPIR-V в один архив. В начале архива текстовый
+# индекс "имя смещение размер", завершённый строкой END и выровненный до 4 байт,
+# смещения считаются от конца индекса.
+# Вызов: cmake -DOUT=<архив> -DFILES=<a.spv|b.spv|...> -P PackShaders.cmake
+string(REPLACE "|" ";" FILES "${FILES}")
+
+set(header "SPVPAK 1\n")
+set(offset 0)
+foreach(f ${FILES})
+    file(SIZE ${f} size)
+    get_filename_component(name ${f} NAME)
+    string(APPEND header "${name} ${offset} ${size}\n")
+    math(EXPR offset "${offset} + ${size}")
+endforeach()
+string(APPEND header "END")
+string(LENGTH "${header}" len)
+math(EXPR pad "(4 - (${len} + 1) % 4) % 4")
+if(pad GREATER 0)
+    string(REPEAT " " ${pad} spaces)
+    string(APPEND header "${spaces}")
+endif()
+string(APPEND header "\n")
+
+file(WRITE ${OUT}.header "${header}")
+execute_process(COMMAND ${CMAKE_COMMAND} -E cat ${OUT}.header ${FILES}
+                OUTPUT_FILE ${OUT}
+                RESULT_VARIABLE result)
+file(REMOVE ${OUT}.header)
+if(NOT result EQUAL 0)
+    message(FATAL_ERROR "Failed to pack shaders into ${OUT}")
+endif()
@@ -1,11 +1,14 @@
 #version 450
+#extension GL_EXT_nonuniform_qualifier : require
 
 layout(location = 0) in vec3 inNormal;
 layout(location = 1) in vec2 inTexCoord;
 layout(location = 2) in vec4 inColor;
 layout(location = 3) in flat int inIsUnlit;
+layout(location = 4) in flat int inTexIndex;
 
-layout(set = 1, binding = 0) uniform sampler2D diffuseTex;
+// Все текстуры материалов; индекс постоянен в пределах отрисовки
+layout(set = 1, binding = 0) uniform sampler2D textures[];
 
 layout(location = 0) out vec4 gNormal;
 layout(location = 1) out vec4 gAlbedo;
@@ -17,7 +20,7 @@ void main() {
         return;
     }
 
-    vec4 diffuse = texture(diffuseTex, inTexCoord);
+    vec4 diffuse = texture(textures[inTexIndex], inTexCoord);
     if (diffuse.a < 0.1) discard;
 
     gNormal = vec4(normalize(inNormal), 0.0);
@@ -4,6 +4,10 @@ layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inNormal;
 layout(location = 2) in vec2 inTexCoord;
 
+// Сжатые вершины: позиция уже деквантуется матрицей модели,
+// нормаль приходит октаэдрической проекцией в xy
+layout(constant_id = 0) const bool PACKED_VERTEX = false;
+
 layout(set = 0, binding = 0) uniform GeomUBO {
     mat4 view;
     mat4 proj;
@@ -11,20 +15,32 @@ layout(set = 0, binding = 0) uniform GeomUBO {
 
 layout(push_constant) uniform PushConstants {
     mat4 model;
+    vec4 normalMat[3]; // столбцы матрицы нормалей, normalMat[0].w - признак unlit, normalMat[1].w - индекс текстуры
     vec4 color;
-    int isUnlit;
 } pc;
 
 layout(location = 0) out vec3 outNormal;
 layout(location = 1) out vec2 outTexCoord;
 layout(location = 2) out vec4 outColor;
 layout(location = 3) out flat int outIsUnlit;
+layout(location = 4) out flat int outTexIndex;
+
+vec3 octDecode(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
 
 void main() {
+    vec3 normal = PACKED_VERTEX ? octDecode(inNormal.xy) : inNormal;
     vec4 worldPos = pc.model * vec4(inPosition, 1.0);
-    outNormal = normalize(transpose(inverse(mat3(pc.model))) * inNormal);
+    mat3 normalMat = mat3(pc.normalMat[0].xyz, pc.normalMat[1].xyz, pc.normalMat[2].xyz);
+    outNormal = normalize(normalMat * normal);
     outTexCoord = inTexCoord;
     outColor = pc.color;
-    outIsUnlit = pc.isUnlit;
+    outIsUnlit = int(pc.normalMat[0].w);
+    outTexIndex = int(pc.normalMat[1].w);
     gl_Position = ubo.proj * ubo.view * worldPos;
 }
@@ -2,6 +2,11 @@
 
 layout(location = 0) in vec2 inUV;
 
+// Варианты конвейера задаются из RenderingSystem::createLightPipeline_
+layout(constant_id = 0) const bool SHADOWS_ENABLED = true;
+layout(constant_id = 1) const int PCF_RADIUS = 1;
+layout(constant_id = 2) const float SHADOW_MAP_SIZE = 2048.0;
+
 layout(set = 0, binding = 0) uniform sampler2D gNormal;
 layout(set = 0, binding = 1) uniform sampler2D gAlbedo;
 layout(set = 0, binding = 2) uniform sampler2D gDepth;
@@ -54,7 +59,7 @@ vec3 evaluateLight(LightData light, vec3 fragPos, vec3 N, vec3 albedo, vec3 view
     if (atten < 1e-5) return vec3(0.0);
 
     float shadow = 0.0;
-    if (light.params2.x > 0.5) {
+    if (SHADOWS_ENABLED && light.params2.x > 0.5) {
         vec4 fragPosLS = light.lightSpace * vec4(fragPos, 1.0);
         vec3 projCoords = fragPosLS.xyz / fragPosLS.w;
         projCoords.xy = projCoords.xy * 0.5 + 0.5;
@@ -64,17 +69,18 @@ vec3 evaluateLight(LightData light, vec3 fragPos, vec3 N, vec3 albedo, vec3 view
                 projCoords.y > 0.0 && projCoords.y < 1.0) {
             float currentDepth = projCoords.z;
             float bias = max(0.005 * (1.0 - dot(N, lightDir)), 0.001);
-            vec2 texelSize = 1.0 / vec2(2048.0);
+            vec2 texelSize = 1.0 / vec2(SHADOW_MAP_SIZE);
             float pcf = 0.0;
 
-            for (int x = -1; x <= 1; ++x) {
-                for (int y = -1; y <= 1; ++y) {
+            for (int x = -PCF_RADIUS; x <= PCF_RADIUS; ++x) {
+                for (int y = -PCF_RADIUS; y <= PCF_RADIUS; ++y) {
                     float pcfDepth = texture(shadowMap, vec3(projCoords.xy + vec2(x, y) * texelSize, light.params2.y)).r;
                     pcf += currentDepth - bias > pcfDepth ? 1.0 : 0.0;
                 }
             }
 
-            shadow = pcf / 9.0;
+            float taps = float(2 * PCF_RADIUS + 1);
+            shadow = pcf / (taps * taps);
         }
     }
 
@@ -93,15 +99,18 @@ vec3 evaluateLight(LightData light, vec3 fragPos, vec3 N, vec3 albedo, vec3 view
 }
 
 void main() {
-    vec3 N = texture(gNormal, inUV).xyz;
-    vec3 albedo = texture(gAlbedo, inUV).rgb;
+    // G-буфер выделен с запасом и больше экрана, поэтому читаем по пикселю,
+    // а не по inUV; inUV остаётся для восстановления позиции
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    vec3 N = texelFetch(gNormal, texel, 0).xyz;
+    vec3 albedo = texelFetch(gAlbedo, texel, 0).rgb;
 
     if (dot(N, N) < 0.5) {
         outColor = vec4(albedo, 1.0);
         return;
     }
 
-    float depth = texture(gDepth, inUV).r;
+    float depth = texelFetch(gDepth, texel, 0).r;
 
     vec4 ndc = vec4(inUV.x * 2.0 - 1.0, inUV.y * 2.0 - 1.0, depth, 1.0);
     vec4 worldPos = lightsUBO.invViewProj * ndc;
@@ -1,5 +1,6 @@
 #version 450
 
+// Для сжатых вершин деквантование позиции вшито в pc.model
 layout(location = 0) in vec3 inPosition;
 
 layout(push_constant) uniform PushConstants {
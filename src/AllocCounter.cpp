@@ -0,0 +1,56 @@
+#include "AllocCounter.h"
+#include <atomic>
+#include <cstdlib>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+#include <new>
+
+static std::atomic<uint64_t> gAllocCount{0};
+
+uint64_t AllocCounter::count() {
+    return gAllocCount.load(std::memory_order_relaxed);
+}
+
+void* operator new(std::size_t size) {
+    gAllocCount.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) { return operator new(size); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+
+// Выровненные перегрузки (C++17): через них идут типы с alignas больше
+// __STDCPP_DEFAULT_NEW_ALIGNMENT__, например SIMD-типы glm
+static void* alignedAlloc(std::size_t size, std::size_t align) {
+#ifdef _WIN32
+    return _aligned_malloc(size, align);
+#else
+    // aligned_alloc требует размер, кратный выравниванию
+    return std::aligned_alloc(align, (size + align - 1) / align * align);
+#endif
+}
+
+static void alignedFree(void* p) {
+#ifdef _WIN32
+    _aligned_free(p);
+#else
+    std::free(p);
+#endif
+}
+
+void* operator new(std::size_t size, std::align_val_t align) {
+    gAllocCount.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = alignedAlloc(size ? size : 1, (std::size_t)align)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size, std::align_val_t align) { return operator new(size, align); }
+void operator delete(void* p, std::align_val_t) noexcept { alignedFree(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { alignedFree(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { alignedFree(p); }
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept { alignedFree(p); }
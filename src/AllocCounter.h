@@ -0,0 +1,8 @@
+#pragma once
+#include <cstdint>
+
+// Счётчик вызовов глобального operator new. Нужен, чтобы проверять,
+// что путь отрисовки не аллоцирует после прогрева.
+namespace AllocCounter {
+    uint64_t count();
+}
@@ -0,0 +1,160 @@
+#include "Benchmark.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+BenchmarkScript BenchmarkScript::load(const std::string& path) {
+    std::ifstream f(path);
+    if (!f.is_open()) throw std::runtime_error("Failed to open benchmark script: " + path);
+    BenchmarkScript s;
+    std::string line;
+    int lineNo = 0;
+    while (std::getline(f, line)) {
+        ++lineNo;
+        std::istringstream in(line);
+        std::string cmd;
+        if (!(in >> cmd) || cmd[0] == '#') continue;
+        bool ok = true;
+        if (cmd == "frames") ok = (bool)(in >> s.frames);
+        else if (cmd == "warmup") ok = (bool)(in >> s.warmup);
+        else if (cmd == "timestep") ok = (bool)(in >> s.timestep) && s.timestep > 0.0f;
+        else if (cmd == "cam") {
+            CameraKey k;
+            ok = (bool)(in >> k.time >> k.position.x >> k.position.y >> k.position.z >> k.yaw >> k.pitch);
+            if (ok) s.path.push_back(k);
+        } else if (cmd == "spawn") {
+            Spawn sp;
+            ok = (bool)(in >> sp.time >> sp.position.x >> sp.position.y >> sp.position.z
+                           >> sp.velocity.x >> sp.velocity.y >> sp.velocity.z >> sp.color.r >> sp.color.g >> sp.color.b);
+            if (ok) s.spawns.push_back(sp);
+        } else ok = false;
+        if (!ok) throw std::runtime_error(path + ":" + std::to_string(lineNo) + ": bad line: " + line);
+    }
+    auto byTime = [](const auto& a, const auto& b) { return a.time < b.time; };
+    std::stable_sort(s.path.begin(), s.path.end(), byTime);
+    std::stable_sort(s.spawns.begin(), s.spawns.end(), byTime);
+    if (s.path.empty()) s.path = makeDefault().path;
+    s.warmup = std::min(s.warmup, s.frames);
+    return s;
+}
+
+// Проход вдоль нефа Sponza и обратно по галерее; фонарики падают по пути
+BenchmarkScript BenchmarkScript::makeDefault() {
+    BenchmarkScript s;
+    s.path = {
+        {0.0f,  {-11.0f, 1.8f,  0.0f},    0.0f,  0.0f},
+        {3.0f,  { -4.0f, 1.8f,  0.5f},    5.0f, -5.0f},
+        {6.0f,  {  4.0f, 2.2f, -0.5f},   -5.0f,  0.0f},
+        {8.0f,  {  9.0f, 3.0f,  0.0f},   60.0f, 10.0f},
+        {10.0f, {  8.0f, 6.5f, -3.5f},  180.0f,  5.0f},
+        {13.0f, { -2.0f, 6.5f, -3.5f},  170.0f, -15.0f},
+        {16.0f, {-10.0f, 4.0f,  0.0f},  270.0f, -20.0f},
+    };
+    for (int i = 0; i < 8; ++i) {
+        float t = 1.0f + (float)i;
+        float x = -9.0f + 2.5f * (float)i;
+        glm::vec3 color{(i % 3 == 0) ? 1.0f : 0.3f, (i % 3 == 1) ? 1.0f : 0.4f, (i % 3 == 2) ? 1.0f : 0.5f};
+        s.spawns.push_back({t, {x, 4.0f, (i % 2) ? 1.5f : -1.5f}, {0.0f, 0.0f, 0.0f}, color * 2.0f + 0.5f});
+    }
+    s.frames = (uint32_t)std::lround(16.0f / s.timestep);
+    return s;
+}
+
+static glm::vec4 catmullRom(const glm::vec4& p0, const glm::vec4& p1, const glm::vec4& p2, const glm::vec4& p3, float u) {
+    float u2 = u * u, u3 = u2 * u;
+    return 0.5f * ((2.0f * p1) + (-p0 + p2) * u + (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * u2 + (-p0 + 3.0f * p1 - 3.0f * p2 + p3) * u3);
+}
+
+// Углы интерполируются как есть — ключи пишутся без скачков yaw через 360
+void BenchmarkScript::sampleCamera(float t, Camera& camera) const {
+    if (path.empty()) return;
+    auto key = [&](size_t i) {
+        const CameraKey& k = path[std::min(i, path.size() - 1)];
+        return glm::vec4(k.position, k.yaw);
+    };
+    size_t i = 0;
+    while (i + 1 < path.size() && path[i + 1].time <= t) ++i;
+    if (i + 1 >= path.size() || t <= path[0].time) {
+        const CameraKey& k = t <= path[0].time ? path[0] : path.back();
+        camera.position = k.position; camera.yaw = k.yaw; camera.pitch = k.pitch;
+        return;
+    }
+    float u = (t - path[i].time) / std::max(path[i + 1].time - path[i].time, 1e-6f);
+    size_t prev = i > 0 ? i - 1 : 0;
+    glm::vec4 p = catmullRom(key(prev), key(i), key(i + 1), key(i + 2), u);
+    float pitch = catmullRom(glm::vec4(path[prev].pitch), glm::vec4(path[i].pitch), glm::vec4(path[i + 1].pitch),
+                             glm::vec4(path[std::min(i + 2, path.size() - 1)].pitch), u).x;
+    camera.position = glm::vec3(p); camera.yaw = p.w; camera.pitch = glm::clamp(pitch, -89.0f, 89.0f);
+}
+
+bool CameraPathRecorder::open(const std::string& path, float step) {
+    file = std::fopen(path.c_str(), "w");
+    if (!file) return false;
+    interval = step;
+    nextTime = 0.0f;
+    std::fprintf(file, "# recorded camera path\n");
+    return true;
+}
+
+void CameraPathRecorder::update(float time, const Camera& camera) {
+    if (!file || time < nextTime) return;
+    std::fprintf(file, "cam %.3f %.4f %.4f %.4f %.3f %.3f\n", time, camera.position.x, camera.position.y, camera.position.z, camera.yaw, camera.pitch);
+    nextTime = time + interval;
+}
+
+CameraPathRecorder::~CameraPathRecorder() {
+    if (file) std::fclose(file);
+}
+
+// Перцентиль по ближайшему рангу
+static double percentile(const std::vector<double>& sorted, double p) {
+    if (sorted.empty()) return 0.0;
+    size_t rank = (size_t)std::ceil(p / 100.0 * (double)sorted.size());
+    return sorted[std::min(std::max<size_t>(rank, 1), sorted.size()) - 1];
+}
+
+static void writeSeries(std::ostream& out, const char* name, std::vector<double> v) {
+    std::sort(v.begin(), v.end());
+    double sum = 0.0;
+    for (double x : v) sum += x;
+    out << "  \"" << name << "\": {\"samples\": " << v.size();
+    if (!v.empty()) {
+        out << ", \"p50\": " << percentile(v, 50) << ", \"p95\": " << percentile(v, 95) << ", \"p99\": " << percentile(v, 99)
+            << ", \"avg\": " << sum / (double)v.size() << ", \"min\": " << v.front() << ", \"max\": " << v.back();
+    }
+    out << "}";
+}
+
+static std::string jsonEscape(const std::string& s) {
+    std::string r;
+    for (char c : s) {
+        if (c == '"' || c == '\\') r += '\\';
+        r += c;
+    }
+    return r;
+}
+
+bool BenchmarkStats::writeJson(const std::string& path, const std::string& scriptName, const std::string& device, uint32_t width, uint32_t height, int framesInFlight) const {
+    std::ofstream out(path, std::ios::trunc);
+    if (!out.is_open()) return false;
+    out << std::fixed << std::setprecision(4);
+    out << "{\n  \"script\": \"" << jsonEscape(scriptName) << "\",\n  \"device\": \"" << jsonEscape(device)
+        << "\",\n  \"width\": " << width << ",\n  \"height\": " << height << ",\n  \"frames_in_flight\": " << framesInFlight << ",\n";
+    writeSeries(out, "cpu_ms", cpuMs); out << ",\n";
+    writeSeries(out, "frame_ms", frameMs); out << ",\n";
+    writeSeries(out, "gpu_ms", gpuMs); out << ",\n";
+    writeSeries(out, "submit_to_observed_ms", submitToObservedMs); out << ",\n";
+    writeSeries(out, "vertices", vertices); out << ",\n";
+    // Среднее по прогону: GPU-времена отстают на кадры в полёте, поэтому
+    // делятся суммы, а не значения отдельных кадров
+    double vertexSum = 0.0, gpuSum = 0.0;
+    for (double v : vertices) vertexSum += v;
+    for (double ms : gpuMs) gpuSum += ms;
+    double gpuFrames = (double)std::max<size_t>(gpuMs.size(), 1), vertexFrames = (double)std::max<size_t>(vertices.size(), 1);
+    out << "  \"mvertices_per_s\": " << (gpuSum > 0.0 ? (vertexSum / vertexFrames) / (gpuSum / gpuFrames) * 1e-3 : 0.0) << "\n}\n";
+    return (bool)out;
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstdio>
+#include "Camera.h"
+
+// Сценарий замера: путь камеры, расписание фонариков и фиксированный шаг.
+// Текстовый формат, по строке на команду ('#' — комментарий):
+//   frames 600            всего кадров
+//   warmup 60             первые кадры не попадают в статистику
+//   timestep 0.0166667    шаг симуляции, с
+//   cam t x y z yaw pitch ключ пути (Catmull-Rom между ключами)
+//   spawn t x y z vx vy vz r g b   фонарик в момент t
+struct BenchmarkScript {
+    struct CameraKey {
+        float time;
+        glm::vec3 position;
+        float yaw, pitch;
+    };
+    struct Spawn {
+        float time;
+        glm::vec3 position, velocity, color;
+    };
+
+    uint32_t frames = 600;
+    uint32_t warmup = 60;
+    float timestep = 1.0f / 60.0f;
+    std::vector<CameraKey> path;
+    std::vector<Spawn> spawns;
+
+    // Пустой путь — облёт сцены по умолчанию
+    static BenchmarkScript load(const std::string& path);
+    static BenchmarkScript makeDefault();
+    void sampleCamera(float t, Camera& camera) const;
+};
+
+// Пишет ключи пути с живой камеры — результат читается BenchmarkScript::load
+class CameraPathRecorder {
+public:
+    bool open(const std::string& path, float interval = 0.25f);
+    void update(float time, const Camera& camera);
+    bool isOpen() const { return file != nullptr; }
+    ~CameraPathRecorder();
+
+private:
+    std::FILE* file = nullptr;
+    float interval = 0.25f;
+    float nextTime = 0.0f;
+};
+
+// Времена кадров после прогрева и их перцентили
+class BenchmarkStats {
+public:
+    void reserve(size_t frames) { cpuMs.reserve(frames); frameMs.reserve(frames); gpuMs.reserve(frames); submitToObservedMs.reserve(frames); vertices.reserve(frames); }
+    void addCpu(double cpu, double frame) { cpuMs.push_back(cpu); frameMs.push_back(frame); }
+    void addGpu(double ms) { gpuMs.push_back(ms); }
+    void addSubmitToObserved(double ms) { submitToObservedMs.push_back(ms); }
+    // Вершины кадра (3 на треугольник, G-буфер и тени) — для пропускной способности
+    void addVertices(uint64_t count) { vertices.push_back((double)count); }
+    bool writeJson(const std::string& path, const std::string& scriptName, const std::string& device, uint32_t width, uint32_t height, int framesInFlight) const;
+
+private:
+    std::vector<double> cpuMs;   // кадр без ожидания fence и acquire
+    std::vector<double> frameMs; // полный кадр
+    std::vector<double> gpuMs;
+    std::vector<double> submitToObservedMs; // от submit до замеченного завершения на GPU
+    std::vector<double> vertices;
+};
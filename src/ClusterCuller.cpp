@@ -0,0 +1,252 @@
+#include "ClusterCuller.h"
+#include <array>
+#include <cstring>
+#include <algorithm>
+
+struct CullPC {
+    glm::vec4 planes[6];
+    glm::vec4 eye;
+};
+
+static constexpr uint32_t MAX_JOBS = 65535; // гарантированный maxComputeWorkGroupCount[1]
+
+void ClusterCuller::init(Engine& engine) {
+    VkDevice dev = engine.getDevice();
+    std::array<VkDescriptorSetLayoutBinding, 5> bindings{};
+    for (uint32_t i = 0; i < bindings.size(); ++i)
+        bindings[i] = {i, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr};
+    VkDescriptorSetLayoutCreateInfo lci{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+    lci.bindingCount = (uint32_t)bindings.size(); lci.pBindings = bindings.data();
+    vkCreateDescriptorSetLayout(dev, &lci, nullptr, &setLayout);
+
+    int count = Engine::MAX_FRAMES;
+    VkDescriptorPoolSize ps{VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, (uint32_t)(bindings.size() * count)};
+    VkDescriptorPoolCreateInfo pci{VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
+    pci.poolSizeCount = 1; pci.pPoolSizes = &ps; pci.maxSets = (uint32_t)count;
+    vkCreateDescriptorPool(dev, &pci, nullptr, &pool);
+    frames.resize(count);
+    std::vector<VkDescriptorSetLayout> layouts(count, setLayout);
+    std::vector<VkDescriptorSet> sets(count);
+    VkDescriptorSetAllocateInfo ai{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
+    ai.descriptorPool = pool; ai.descriptorSetCount = (uint32_t)count; ai.pSetLayouts = layouts.data();
+    vkAllocateDescriptorSets(dev, &ai, sets.data());
+    for (int i = 0; i < count; ++i) frames[i].set = sets[i];
+
+    createPipeline_(engine);
+}
+
+void ClusterCuller::cleanup(VkDevice device) {
+    for (auto& f : frames) destroyFrame_(device, f);
+    frames.clear();
+    vkDestroyBuffer(device, meshletBuf, nullptr); vkFreeMemory(device, meshletMem, nullptr);
+    vkDestroyBuffer(device, srcIndexBuf, nullptr); vkFreeMemory(device, srcIndexMem, nullptr);
+    meshletBuf = srcIndexBuf = VK_NULL_HANDLE; meshletMem = srcIndexMem = VK_NULL_HANDLE;
+    meshletCapacity = srcIndexCapacity = 0;
+    vkDestroyPipeline(device, pipeline, nullptr);
+    vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+    vkDestroyDescriptorPool(device, pool, nullptr);
+    vkDestroyDescriptorSetLayout(device, setLayout, nullptr);
+}
+
+uint32_t ClusterCuller::addJob(const Engine& engine, MeshHandle mesh, const glm::mat4& world, bool coneCulling) {
+    if (jobs.size() >= MAX_JOBS) return UINT32_MAX;
+    Job j;
+    j.world = world;
+    j.firstMeshlet = engine.getFirstMeshlet(mesh);
+    j.meshletCount = engine.getMeshletCount(mesh);
+    j.outOffset = (uint32_t)indexTotal;
+    j.flags = coneCulling ? 1u : 0u;
+    indexTotal += engine.getMeshLod(mesh, 0).indexCount;
+    maxMeshletsPerJob = std::max(maxMeshletsPerJob, j.meshletCount);
+    jobs.push_back(j);
+    return (uint32_t)jobs.size() - 1;
+}
+
+void ClusterCuller::dispatch(VkCommandBuffer cmd, Engine& engine, int frameIndex, const glm::vec4 (&planes)[6], const glm::vec3& eye) {
+    if (jobs.empty()) return;
+    FrameBuffers& f = frames[frameIndex];
+    syncMeshlets_(cmd, engine, f);
+    ensureFrameCapacity_(engine, f);
+    if (f.setDirty) writeSet_(engine.getDevice(), f);
+
+    memcpy(f.jobMapped, jobs.data(), sizeof(Job) * jobs.size());
+    auto* draws = static_cast<VkDrawIndexedIndirectCommand*>(f.drawMapped);
+    for (size_t i = 0; i < jobs.size(); ++i) draws[i] = {0, 1, jobs[i].outOffset, 0, 0};
+
+    CullPC pc{};
+    for (int i = 0; i < 6; ++i) pc.planes[i] = planes[i];
+    pc.eye = glm::vec4(eye, 0.0f);
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &f.set, 0, nullptr);
+    vkCmdPushConstants(cmd, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullPC), &pc);
+    vkCmdDispatch(cmd, (maxMeshletsPerJob + GROUP_SIZE - 1) / GROUP_SIZE, (uint32_t)jobs.size(), 1);
+
+    VkMemoryBarrier mb{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+    mb.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    mb.dstAccessMask = VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
+                         0, 1, &mb, 0, nullptr, 0, nullptr);
+}
+
+void ClusterCuller::drawJob(VkCommandBuffer cmd, const Engine& engine, int frameIndex, MeshHandle mesh, uint32_t job) const {
+    const FrameBuffers& f = frames[frameIndex];
+    engine.bindAndDrawMeshIndirect_(cmd, mesh, f.indexBuf, f.drawBuf, job * sizeof(VkDrawIndexedIndirectCommand));
+}
+
+void ClusterCuller::createPipeline_(Engine& engine) {
+    VkDevice dev = engine.getDevice();
+    VkPushConstantRange pcr{VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullPC)};
+    VkPipelineLayoutCreateInfo plci{VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
+    plci.setLayoutCount = 1; plci.pSetLayouts = &setLayout;
+    plci.pushConstantRangeCount = 1; plci.pPushConstantRanges = &pcr;
+    vkCreatePipelineLayout(dev, &plci, nullptr, &pipelineLayout);
+    pipeline = buildPipeline_(engine);
+}
+
+VkPipeline ClusterCuller::buildPipeline_(Engine& engine) const {
+    VkShaderModule sm = engine.getShaderModule("shaders/cull.comp.spv");
+    VkComputePipelineCreateInfo ci{VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO};
+    ci.stage = {VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO};
+    ci.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT; ci.stage.module = sm; ci.stage.pName = "main";
+    ci.layout = pipelineLayout;
+    VkPipeline created = VK_NULL_HANDLE;
+    vkCreateComputePipelines(engine.getDevice(), engine.getPipelineCache(), 1, &ci, nullptr, &created);
+    return created;
+}
+
+bool ClusterCuller::reloadPipeline(Engine& engine) {
+    VkPipeline created = buildPipeline_(engine);
+    if (!created) return false;
+    engine.retire(VK_OBJECT_TYPE_PIPELINE, pipeline);
+    pipeline = created;
+    return true;
+}
+
+// Новые меши дописывают свои диапазоны копией из staging-буфера кадра в том же
+// командном буфере, что и dispatch, — без vkQueueWaitIdle. Удаление меша
+// ничего не перезаливает: его диапазоны просто отдаются следующим мешам.
+void ClusterCuller::syncMeshlets_(VkCommandBuffer cmd, Engine& engine, FrameBuffers& f) {
+    engine.takeMeshletWrites(meshletWrites);
+    const auto& meshlets = engine.getMeshlets();
+    const auto& indices = engine.getMeshletIndices();
+    bool grow = meshlets.size() > meshletCapacity || indices.size() > srcIndexCapacity;
+    if (meshletWrites.empty() && !grow) return;
+
+    // Копии прошлых кадров закончены, а dispatch прошлых кадров дочитал
+    // переиспользуемые диапазоны, прежде чем их перезапишут
+    VkMemoryBarrier mb{VK_STRUCTURE_TYPE_MEMORY_BARRIER};
+    mb.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    mb.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         0, 1, &mb, 0, nullptr, 0, nullptr);
+    if (grow) {
+        if (meshlets.size() > meshletCapacity) growShared_(cmd, engine, meshletBuf, meshletMem, meshletCapacity, meshlets.size(), sizeof(Meshlet));
+        if (indices.size() > srcIndexCapacity) growShared_(cmd, engine, srcIndexBuf, srcIndexMem, srcIndexCapacity, indices.size(), sizeof(uint32_t));
+        // Перенос старого содержимого — до записи новых диапазонов поверх
+        mb.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &mb, 0, nullptr, 0, nullptr);
+    }
+
+    VkDeviceSize bytes = 0;
+    for (const MeshletRange& w : meshletWrites) bytes += sizeof(Meshlet) * w.meshletCount + sizeof(uint32_t) * w.indexCount;
+    // Кадр с этим индексом уже дождался своего фенса — staging свободен
+    if (bytes > f.stagingCapacity) {
+        VkDevice dev = engine.getDevice();
+        vkDestroyBuffer(dev, f.stagingBuf, nullptr); vkFreeMemory(dev, f.stagingMem, nullptr);
+        f.stagingCapacity = std::max<VkDeviceSize>(1 << 20, f.stagingCapacity * 2);
+        while (f.stagingCapacity < bytes) f.stagingCapacity *= 2;
+        engine.createBuffer(f.stagingCapacity, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, f.stagingBuf, f.stagingMem);
+        vkMapMemory(dev, f.stagingMem, 0, VK_WHOLE_SIZE, 0, &f.stagingMapped);
+    }
+    auto* staging = static_cast<char*>(f.stagingMapped);
+    VkDeviceSize offset = 0;
+    meshletCopies.clear();
+    indexCopies.clear();
+    for (const MeshletRange& w : meshletWrites) {
+        VkDeviceSize size = sizeof(Meshlet) * w.meshletCount;
+        memcpy(staging + offset, meshlets.data() + w.firstMeshlet, size);
+        meshletCopies.push_back({offset, sizeof(Meshlet) * w.firstMeshlet, size});
+        offset += size;
+        size = sizeof(uint32_t) * w.indexCount;
+        memcpy(staging + offset, indices.data() + w.firstIndex, size);
+        indexCopies.push_back({offset, sizeof(uint32_t) * w.firstIndex, size});
+        offset += size;
+    }
+    meshletWrites.clear();
+    if (!meshletCopies.empty()) {
+        vkCmdCopyBuffer(cmd, f.stagingBuf, meshletBuf, (uint32_t)meshletCopies.size(), meshletCopies.data());
+        vkCmdCopyBuffer(cmd, f.stagingBuf, srcIndexBuf, (uint32_t)indexCopies.size(), indexCopies.data());
+    }
+
+    mb.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    mb.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &mb, 0, nullptr, 0, nullptr);
+}
+
+// Общие буферы растут удвоением; старое содержимое копируется на GPU. Наборы
+// других слотов ещё ссылаются на старый буфер: они переписываются в dispatch
+// своего кадра, а буфер удаляется после завершения отправленных кадров.
+void ClusterCuller::growShared_(VkCommandBuffer cmd, Engine& engine, VkBuffer& buf, VkDeviceMemory& mem, size_t& capacity, size_t needed, size_t stride) {
+    size_t grown = std::max<size_t>(1 << 12, capacity * 2);
+    while (grown < needed) grown *= 2;
+    VkBuffer newBuf; VkDeviceMemory newMem;
+    engine.createBuffer(stride * grown, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, newBuf, newMem);
+    if (buf) {
+        VkBufferCopy region{0, 0, stride * capacity};
+        vkCmdCopyBuffer(cmd, buf, newBuf, 1, &region);
+        engine.retire(VK_OBJECT_TYPE_BUFFER, buf); engine.retire(VK_OBJECT_TYPE_DEVICE_MEMORY, mem);
+    }
+    buf = newBuf; mem = newMem;
+    capacity = grown;
+    for (auto& f : frames) f.setDirty = true;
+}
+
+// Буферы кадра растут удвоением. Кадр с этим индексом уже дождался своего
+// фенса, поэтому старые буферы можно удалять без ожидания устройства.
+void ClusterCuller::ensureFrameCapacity_(Engine& engine, FrameBuffers& f) {
+    VkDevice dev = engine.getDevice();
+    if (jobs.size() > f.jobCapacity) {
+        vkDestroyBuffer(dev, f.jobBuf, nullptr); vkFreeMemory(dev, f.jobMem, nullptr);
+        vkDestroyBuffer(dev, f.drawBuf, nullptr); vkFreeMemory(dev, f.drawMem, nullptr);
+        f.jobCapacity = std::max<size_t>(256, f.jobCapacity * 2);
+        while (f.jobCapacity < jobs.size()) f.jobCapacity *= 2;
+        VkMemoryPropertyFlags host = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+        engine.createBuffer(sizeof(Job) * f.jobCapacity, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, host, f.jobBuf, f.jobMem);
+        engine.createBuffer(sizeof(VkDrawIndexedIndirectCommand) * f.jobCapacity, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, host, f.drawBuf, f.drawMem);
+        vkMapMemory(dev, f.jobMem, 0, VK_WHOLE_SIZE, 0, &f.jobMapped);
+        vkMapMemory(dev, f.drawMem, 0, VK_WHOLE_SIZE, 0, &f.drawMapped);
+        f.setDirty = true;
+    }
+    if (indexTotal > f.indexCapacity) {
+        vkDestroyBuffer(dev, f.indexBuf, nullptr); vkFreeMemory(dev, f.indexMem, nullptr);
+        f.indexCapacity = std::max<size_t>(1 << 16, f.indexCapacity * 2);
+        while (f.indexCapacity < indexTotal) f.indexCapacity *= 2;
+        engine.createBuffer(sizeof(uint32_t) * f.indexCapacity, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, f.indexBuf, f.indexMem);
+        f.setDirty = true;
+    }
+}
+
+void ClusterCuller::writeSet_(VkDevice device, FrameBuffers& f) {
+    VkDescriptorBufferInfo infos[5] = {
+        {meshletBuf, 0, VK_WHOLE_SIZE}, {srcIndexBuf, 0, VK_WHOLE_SIZE}, {f.jobBuf, 0, VK_WHOLE_SIZE},
+        {f.indexBuf, 0, VK_WHOLE_SIZE}, {f.drawBuf, 0, VK_WHOLE_SIZE},
+    };
+    std::array<VkWriteDescriptorSet, 5> writes{};
+    for (uint32_t i = 0; i < writes.size(); ++i) {
+        writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET; writes[i].dstSet = f.set; writes[i].dstBinding = i;
+        writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER; writes[i].descriptorCount = 1; writes[i].pBufferInfo = &infos[i];
+    }
+    vkUpdateDescriptorSets(device, (uint32_t)writes.size(), writes.data(), 0, nullptr);
+    f.setDirty = false;
+}
+
+void ClusterCuller::destroyFrame_(VkDevice device, FrameBuffers& f) {
+    vkDestroyBuffer(device, f.jobBuf, nullptr); vkFreeMemory(device, f.jobMem, nullptr);
+    vkDestroyBuffer(device, f.drawBuf, nullptr); vkFreeMemory(device, f.drawMem, nullptr);
+    vkDestroyBuffer(device, f.indexBuf, nullptr); vkFreeMemory(device, f.indexMem, nullptr);
+    vkDestroyBuffer(device, f.stagingBuf, nullptr); vkFreeMemory(device, f.stagingMem, nullptr);
+    f = FrameBuffers{};
+}
@@ -0,0 +1,83 @@
+#pragma once
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+#include <vector>
+#include "Engine.h"
+
+// GPU-отсечение кластеров (meshlet) перед G-буфером. На каждую отрисовку
+// сабмеша заводится задание; compute-шейдер проверяет кластеры по фрустуму
+// и конусу нормалей и дописывает индексы выживших в общий индексный буфер
+// кадра, а число индексов — в indirect-команду задания.
+class ClusterCuller {
+public:
+    static constexpr uint32_t GROUP_SIZE = 64;
+
+    void init(Engine& engine);
+    void cleanup(VkDevice device);
+
+    void clearJobs() { jobs.clear(); indexTotal = 0; maxMeshletsPerJob = 0; }
+    // Возвращает номер indirect-команды для drawJob или UINT32_MAX, если заданий
+    // больше, чем допускает dispatch по оси Y — тогда сабмеш рисуется целиком.
+    // coneCulling — только когда изнанка кластеров не видна: задние грани
+    // отбрасываются или меш замкнут и камера снаружи него
+    uint32_t addJob(const Engine& engine, MeshHandle mesh, const glm::mat4& world, bool coneCulling);
+    size_t jobCount() const { return jobs.size(); }
+
+    // Записывается вне render pass; барьер до чтения индексов включён
+    void dispatch(VkCommandBuffer cmd, Engine& engine, int frameIndex, const glm::vec4 (&planes)[6], const glm::vec3& eye);
+    void drawJob(VkCommandBuffer cmd, const Engine& engine, int frameIndex, MeshHandle mesh, uint32_t job) const;
+    // Горячая перезагрузка cull.comp; если конвейер не создался, остаётся старый
+    bool reloadPipeline(Engine& engine);
+
+private:
+    // std430, как в cull.comp
+    struct Job {
+        glm::mat4 world;
+        uint32_t firstMeshlet;
+        uint32_t meshletCount;
+        uint32_t outOffset;
+        uint32_t flags; // бит 0 — отсечение по конусу
+    };
+
+    struct FrameBuffers {
+        VkBuffer jobBuf = VK_NULL_HANDLE, drawBuf = VK_NULL_HANDLE, indexBuf = VK_NULL_HANDLE;
+        VkDeviceMemory jobMem = VK_NULL_HANDLE, drawMem = VK_NULL_HANDLE, indexMem = VK_NULL_HANDLE;
+        void* jobMapped = nullptr;
+        void* drawMapped = nullptr;
+        size_t jobCapacity = 0;
+        size_t indexCapacity = 0;
+        // Новые кластеры этого кадра по пути в meshletBuf/srcIndexBuf
+        VkBuffer stagingBuf = VK_NULL_HANDLE;
+        VkDeviceMemory stagingMem = VK_NULL_HANDLE;
+        void* stagingMapped = nullptr;
+        VkDeviceSize stagingCapacity = 0;
+        bool setDirty = true;
+        VkDescriptorSet set = VK_NULL_HANDLE;
+    };
+
+    VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+    VkDescriptorPool pool = VK_NULL_HANDLE;
+    VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+    VkPipeline pipeline = VK_NULL_HANDLE;
+
+    // Общие для всех кадров: кластеры и их исходные индексы, ёмкость в элементах
+    VkBuffer meshletBuf = VK_NULL_HANDLE, srcIndexBuf = VK_NULL_HANDLE;
+    VkDeviceMemory meshletMem = VK_NULL_HANDLE, srcIndexMem = VK_NULL_HANDLE;
+    size_t meshletCapacity = 0, srcIndexCapacity = 0;
+    std::vector<MeshletRange> meshletWrites;
+    std::vector<VkBufferCopy> meshletCopies, indexCopies;
+
+    std::vector<FrameBuffers> frames;
+    std::vector<Job> jobs;
+    uint32_t maxMeshletsPerJob = 0;
+    size_t indexTotal = 0;
+
+    void createPipeline_(Engine& engine);
+    VkPipeline buildPipeline_(Engine& engine) const;
+    void syncMeshlets_(VkCommandBuffer cmd, Engine& engine, FrameBuffers& f);
+    void growShared_(VkCommandBuffer cmd, Engine& engine, VkBuffer& buf, VkDeviceMemory& mem, size_t& capacity, size_t needed, size_t stride);
+    void ensureFrameCapacity_(Engine& engine, FrameBuffers& f);
+    void writeSet_(VkDevice device, FrameBuffers& f);
+    void destroyFrame_(VkDevice device, FrameBuffers& f);
+};
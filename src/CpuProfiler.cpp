@@ -0,0 +1,126 @@
+#include "CpuProfiler.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace CpuProfiler {
+
+namespace {
+
+// Слот кольца под seqlock: seq = номер события + 1, пока слот цел, и WRITING
+// на время записи. Читатель из другого потока берёт событие, только если seq
+// до и после чтения полей совпал с ожидаемым номером.
+struct Event {
+    static constexpr uint64_t WRITING = ~0ull;
+    std::atomic<uint64_t> seq{0};
+    std::atomic<const char*> name{nullptr};
+    std::atomic<uint64_t> start{0}, end{0};
+};
+
+// Пишет только поток-владелец; written публикуется с release, чтобы выгрузка
+// из другого потока видела заполненные события
+struct ThreadBuffer {
+    uint32_t tid = 0;
+    const char* name = nullptr;
+    std::unique_ptr<Event[]> events{new Event[BUFFER_EVENTS]};
+    std::atomic<uint64_t> written{0};
+};
+
+std::atomic<bool> enabledFlag{true};
+std::mutex registryMutex;
+// Буферы живут до конца процесса: трассу можно выгрузить и после выхода потока
+std::vector<std::unique_ptr<ThreadBuffer>> registry;
+const uint64_t epochNs = nowNs();
+thread_local ThreadBuffer* localBuffer = nullptr;
+
+ThreadBuffer& local() {
+    if (!localBuffer) {
+        auto b = std::make_unique<ThreadBuffer>();
+        std::lock_guard<std::mutex> lock(registryMutex);
+        b->tid = (uint32_t)registry.size() + 1;
+        localBuffer = b.get();
+        registry.push_back(std::move(b));
+    }
+    return *localBuffer;
+}
+
+void writeString(std::ostream& out, const char* s) {
+    out << '"';
+    for (; *s; ++s) {
+        if (*s == '"' || *s == '\\') out << '\\';
+        out << *s;
+    }
+    out << '"';
+}
+
+} // namespace
+
+void setEnabled(bool enabled) { enabledFlag.store(enabled, std::memory_order_relaxed); }
+bool isEnabled() { return enabledFlag.load(std::memory_order_relaxed); }
+
+void setThreadName(const char* name) {
+    ThreadBuffer& b = local();
+    std::lock_guard<std::mutex> lock(registryMutex);
+    b.name = name;
+}
+
+uint64_t nowNs() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void record(const char* name, uint64_t startNs, uint64_t endNs) {
+    ThreadBuffer& b = local();
+    uint64_t n = b.written.load(std::memory_order_relaxed);
+    Event& e = b.events[n % BUFFER_EVENTS];
+    e.seq.store(Event::WRITING, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    e.name.store(name, std::memory_order_relaxed);
+    e.start.store(startNs, std::memory_order_relaxed);
+    e.end.store(endNs, std::memory_order_relaxed);
+    e.seq.store(n + 1, std::memory_order_release);
+    b.written.store(n + 1, std::memory_order_release);
+}
+
+// Если поток пишет во время выгрузки, самые старые события кольца могут быть
+// уже перезаписаны — такие слоты отсеивает проверка seq
+bool writeChromeTrace(const std::string& path) {
+    std::ofstream out(path, std::ios::trunc);
+    if (!out.is_open()) return false;
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    out << std::fixed << std::setprecision(3);
+    bool first = true;
+    std::lock_guard<std::mutex> lock(registryMutex);
+    for (const auto& b : registry) {
+        if (b->name) {
+            out << (first ? "" : ",\n") << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << b->tid << ",\"args\":{\"name\":";
+            writeString(out, b->name);
+            out << "}}";
+            first = false;
+        }
+        uint64_t n = b->written.load(std::memory_order_acquire);
+        uint64_t begin = n > BUFFER_EVENTS ? n - BUFFER_EVENTS : 0;
+        for (uint64_t i = begin; i < n; ++i) {
+            const Event& e = b->events[i % BUFFER_EVENTS];
+            if (e.seq.load(std::memory_order_acquire) != i + 1) continue;
+            const char* name = e.name.load(std::memory_order_relaxed);
+            uint64_t start = e.start.load(std::memory_order_relaxed);
+            uint64_t end = e.end.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (e.seq.load(std::memory_order_relaxed) != i + 1 || start < epochNs) continue;
+            out << (first ? "" : ",\n") << "{\"ph\":\"X\",\"name\":";
+            writeString(out, name);
+            out << ",\"pid\":1,\"tid\":" << b->tid << ",\"ts\":" << (double)(start - epochNs) * 1e-3
+                << ",\"dur\":" << (double)(end - start) * 1e-3 << "}";
+            first = false;
+        }
+    }
+    out << "\n]}\n";
+    return (bool)out;
+}
+
+} // namespace CpuProfiler
@@ -0,0 +1,40 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+// Scoped-зоны CPU для захватов в формате Chrome trace (chrome://tracing,
+// ui.perfetto.dev). Каждый поток пишет в свой кольцевой буфер без блокировок;
+// мьютекс берётся только при первой зоне потока и при выгрузке.
+// Имена зон — строковые литералы: сохраняется только указатель.
+namespace CpuProfiler {
+
+// Событий на поток; при переполнении затираются самые старые
+constexpr uint32_t BUFFER_EVENTS = 1u << 16;
+
+void setEnabled(bool enabled);
+bool isEnabled();
+// Имя потока в трассе; вызывать из самого потока
+void setThreadName(const char* name);
+
+uint64_t nowNs();
+void record(const char* name, uint64_t startNs, uint64_t endNs);
+
+// Выгружает всё, что сейчас лежит в буферах всех потоков
+bool writeChromeTrace(const std::string& path);
+
+class Scope {
+public:
+    explicit Scope(const char* name) : name(name), start(isEnabled() ? nowNs() : 0) {}
+    ~Scope() { if (start) record(name, start, nowNs()); }
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+private:
+    const char* name;
+    uint64_t start;
+};
+
+} // namespace CpuProfiler
+
+#define CPU_ZONE_CAT2(a, b) a##b
+#define CPU_ZONE_CAT(a, b) CPU_ZONE_CAT2(a, b)
+#define CPU_ZONE(name) CpuProfiler::Scope CPU_ZONE_CAT(cpuZone_, __LINE__)(name)
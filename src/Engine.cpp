@@ -1,13 +1,36 @@
 #include "Engine.h"
+#include "CpuProfiler.h"
 #include <stdexcept>
 #include <fstream>
 #include <iostream>
 #include <set>
+#include <string>
 #include <algorithm>
 #include <cstring>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include <sstream>
+#include <filesystem>
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+
+const Engine::MeshRes Engine::EMPTY_MESH{};
 
 static const std::vector<const char*> kDeviceExtensions = {
     VK_KHR_SWAPCHAIN_EXTENSION_NAME
@@ -15,11 +38,24 @@ static const std::vector<const char*> kDeviceExtensions = {
 
 void Engine::init(GLFWwindow* w) {
     window = w;
+    init_();
+}
+
+void Engine::initHeadless(uint32_t width, uint32_t height) {
+    headless = true;
+    swapExtent = {width, height};
+    init_();
+}
+
+void Engine::init_() {
     createInstance_();
-    createSurface_(w);
+    if (!headless) createSurface_(window);
     pickPhysDevice_();
     createDevice_();
-    createSwapchain_();
+    createPipelineCache_();
+    gpuProfiler.init(physDevice, device, graphicsFamily, physProps.limits.timestampPeriod, MAX_FRAMES, pipelineStatsSupported);
+    if (headless) createOffscreenTargets_();
+    else createSwapchain_();
     createCommandPool_();
     createCommandBuffers_();
     createSyncObjects_();
@@ -30,61 +66,123 @@ void Engine::init(GLFWwindow* w) {
 void Engine::cleanup() {
     vkDeviceWaitIdle(device);
     for (auto& t : textures) {
-        vkDestroySampler(device, t.sampler, nullptr);
         vkDestroyImageView(device, t.view, nullptr);
         vkDestroyImage(device, t.image, nullptr);
         vkFreeMemory(device, t.memory, nullptr);
     }
     for (auto& m : meshes) {
+        vkDestroyBuffer(device, m.pb, nullptr); vkFreeMemory(device, m.pm, nullptr);
         vkDestroyBuffer(device, m.vb, nullptr); vkFreeMemory(device, m.vm, nullptr);
         vkDestroyBuffer(device, m.ib, nullptr); vkFreeMemory(device, m.im, nullptr);
     }
+    flushFrameCaptures();
+    for (auto& c : captures) {
+        vkDestroyBuffer(device, c.buffer, nullptr);
+        vkFreeMemory(device, c.memory, nullptr);
+    }
+    captures.clear();
+    gpuProfiler.cleanup(device);
+    savePipelineCache_();
+    vkDestroyPipelineCache(device, pipelineCache, nullptr);
+    for (auto& [hash, entry] : shadersByHash) vkDestroyShaderModule(device, entry.module, nullptr);
+    shadersByHash.clear(); shadersByName.clear();
+    closeShaderArchive_();
+    for (auto& [key, sampler] : samplers) vkDestroySampler(device, sampler, nullptr);
+    samplers.clear();
     vkDestroyDescriptorPool(device, materialPool, nullptr);
     vkDestroyDescriptorSetLayout(device, materialLayout, nullptr);
     for (int i = 0; i < MAX_FRAMES; ++i) {
         vkDestroySemaphore(device, imageAvailable[i], nullptr);
         vkDestroySemaphore(device, renderFinished[i], nullptr);
-        vkDestroyFence(device, inFlightFences[i], nullptr);
     }
+    vkDestroySemaphore(device, frameTimeline, nullptr);
     vkDestroyCommandPool(device, commandPool, nullptr);
+    destroyRetired_(true);
+    destroyOldSwapchains_(true);
+    for (auto f : presentFences) vkDestroyFence(device, f, nullptr);
     cleanupSwapchain_();
     vkDestroyDevice(device, nullptr);
-    vkDestroySurfaceKHR(instance, surface, nullptr);
+    if (surface) vkDestroySurfaceKHR(instance, surface, nullptr);
     vkDestroyInstance(instance, nullptr);
 }
 
+// Кадров в полёте может стать меньше на ходу, поэтому кроме прошлого кадра
+// слота ждём всё, что старше framesInFlight - 1 последних отправок
 FrameContext Engine::beginFrame() {
-    vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
-    uint32_t imageIndex;
-    VkResult res = vkAcquireNextImageKHR(device, swapchain, UINT64_MAX, imageAvailable[currentFrame], VK_NULL_HANDLE, &imageIndex);
+    if (currentFrame >= framesInFlight) currentFrame = 0;
+    uint64_t oldest = submittedFrames >= (uint64_t)framesInFlight ? submittedFrames - framesInFlight + 1 : 0;
+    {
+        CPU_ZONE("frame wait");
+        waitFrame_(std::max(slotValues[currentFrame], oldest));
+    }
+    updateSubmitToObserved_();
+    destroyRetired_(false);
+    destroyOldSwapchains_(false);
+    if (!captures.empty() && captures[currentFrame].pending) writeCapture_(captures[currentFrame]);
+    if (swapchainDirty && !headless) return {VK_NULL_HANDLE, 0, currentFrame, false};
+    uint32_t imageIndex = (uint32_t)currentFrame; // headless: своё изображение у каждого кадра в полёте
+    VkResult res = VK_SUCCESS;
+    if (!headless) {
+        CPU_ZONE("acquire");
+        res = vkAcquireNextImageKHR(device, swapchain, UINT64_MAX, imageAvailable[currentFrame], VK_NULL_HANDLE, &imageIndex);
+    }
     if (res == VK_ERROR_OUT_OF_DATE_KHR) {
         return {VK_NULL_HANDLE, 0, currentFrame, false};
     }
     if (res != VK_SUCCESS && res != VK_SUBOPTIMAL_KHR) throw std::runtime_error("vkAcquireNextImageKHR failed");
-    if (imagesInFlight[imageIndex] != VK_NULL_HANDLE) vkWaitForFences(device, 1, &imagesInFlight[imageIndex], VK_TRUE, UINT64_MAX);
-    imagesInFlight[imageIndex] = inFlightFences[currentFrame];
+    if (!headless)
+        for (auto& old : oldSwapchains) old.acquiresLeft -= old.acquiresLeft ? 1 : 0;
+    if (imageValues[imageIndex] != 0) {
+        CPU_ZONE("image wait");
+        waitFrame_(imageValues[imageIndex]);
+    }
+    // Этот кадр получит значение submittedFrames + 1 в endFrame
+    imageValues[imageIndex] = submittedFrames + 1;
     VkCommandBuffer cmd = commandBuffers[currentFrame];
     vkResetCommandBuffer(cmd, 0);
     VkCommandBufferBeginInfo bi{VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
     vkBeginCommandBuffer(cmd, &bi);
+    gpuProfiler.beginFrame(cmd, currentFrame);
+    frameOpen = true;
     return {cmd, imageIndex, currentFrame, true};
 }
 
 void Engine::endFrame(const FrameContext& ctx) {
     if (!ctx.valid) return;
+    if (capturePending) recordCapture_(ctx.cmd, ctx.imageIndex, ctx.frameIndex);
     vkEndCommandBuffer(ctx.cmd);
+    uint64_t frameValue = ++submittedFrames;
+    frameOpen = false;
+    slotValues[ctx.frameIndex] = frameValue;
     VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    // Timeline идёт первым: headless отрезает бинарный семафор present
+    VkSemaphore signals[2] = {frameTimeline, renderFinished[ctx.frameIndex]};
+    uint64_t signalValues[2] = {frameValue, 0};
+    uint64_t waitValue = 0; // бинарный семафор, значение игнорируется
+    VkTimelineSemaphoreSubmitInfo ti{VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO};
     VkSubmitInfo si{};
     si.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    si.pNext = &ti;
     si.waitSemaphoreCount = 1;
     si.pWaitSemaphores = &imageAvailable[ctx.frameIndex];
     si.pWaitDstStageMask = &waitStage;
     si.commandBufferCount = 1;
     si.pCommandBuffers = &ctx.cmd;
-    si.signalSemaphoreCount = 1;
-    si.pSignalSemaphores = &renderFinished[ctx.frameIndex];
-    vkResetFences(device, 1, &inFlightFences[ctx.frameIndex]);
-    vkQueueSubmit(graphicsQueue, 1, &si, inFlightFences[ctx.frameIndex]);
+    si.signalSemaphoreCount = 2;
+    si.pSignalSemaphores = signals;
+    // Без present некому ждать бинарные семафоры — headless-кадр отмечается только в timeline
+    if (headless) { si.waitSemaphoreCount = 0; si.signalSemaphoreCount = 1; }
+    ti.waitSemaphoreValueCount = si.waitSemaphoreCount; ti.pWaitSemaphoreValues = &waitValue;
+    ti.signalSemaphoreValueCount = si.signalSemaphoreCount; ti.pSignalSemaphoreValues = signalValues;
+    submitTimes[frameValue % SUBMIT_RING] = CpuProfiler::nowNs();
+    {
+        CPU_ZONE("submit");
+        vkQueueSubmit(graphicsQueue, 1, &si, VK_NULL_HANDLE);
+    }
+    if (headless) {
+        currentFrame = (currentFrame + 1) % framesInFlight;
+        return;
+    }
     VkPresentInfoKHR pi{};
     pi.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
     pi.waitSemaphoreCount = 1;
@@ -92,11 +190,202 @@ void Engine::endFrame(const FrameContext& ctx) {
     pi.swapchainCount = 1;
     pi.pSwapchains = &swapchain;
     pi.pImageIndices = &ctx.imageIndex;
-    vkQueuePresentKHR(presentQueue, &pi);
-    currentFrame = (currentFrame + 1) % MAX_FRAMES;
+#ifdef VK_EXT_swapchain_maintenance1
+    VkSwapchainPresentFenceInfoEXT fenceInfo{VK_STRUCTURE_TYPE_SWAPCHAIN_PRESENT_FENCE_INFO_EXT};
+    if (swapchainMaintenance1) {
+        // Прошлый present слота был framesInFlight кадров назад — ожидание короткое
+        uint32_t bit = 1u << ctx.frameIndex;
+        VkFence& fence = presentFences[ctx.frameIndex];
+        if (presentFencesUsed & bit) {
+            vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
+            vkResetFences(device, 1, &fence);
+            for (auto& old : oldSwapchains) old.pendingFences &= ~bit;
+        }
+        presentFencesUsed &= ~bit;
+        fenceInfo.swapchainCount = 1;
+        fenceInfo.pFences = &fence;
+        pi.pNext = &fenceInfo;
+    }
+#endif
+    VkResult presentRes;
+    {
+        CPU_ZONE("present");
+        presentRes = vkQueuePresentKHR(presentQueue, &pi);
+    }
+    // OUT_OF_DATE present всё равно поставлен в очередь, и fence сработает;
+    // после прочих ошибок ждать его нельзя
+    if (swapchainMaintenance1 && (presentRes >= 0 || presentRes == VK_ERROR_OUT_OF_DATE_KHR))
+        presentFencesUsed |= 1u << ctx.frameIndex;
+    currentFrame = (currentFrame + 1) % framesInFlight;
+}
+
+void Engine::setPresentMode(VkPresentModeKHR mode) {
+    if (mode == requestedPresentMode) return;
+    requestedPresentMode = mode;
+    swapchainDirty = true;
+}
+
+void Engine::setSwapImageCount(uint32_t count) {
+    if (count == requestedImageCount) return;
+    requestedImageCount = count;
+    swapchainDirty = true;
+}
+
+bool Engine::isPresentModeSupported(VkPresentModeKHR mode) const {
+    return std::find(supportedPresentModes.begin(), supportedPresentModes.end(), mode) != supportedPresentModes.end();
+}
+
+void Engine::waitFrame_(uint64_t value) {
+    if (value == 0) return;
+    VkSemaphoreWaitInfo wi{VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO};
+    wi.semaphoreCount = 1; wi.pSemaphores = &frameTimeline; wi.pValues = &value;
+    vkWaitSemaphores(device, &wi, UINT64_MAX);
+}
+
+// Порядок удаления — порядок retire: виды раньше изображений, изображения
+// раньше памяти
+void Engine::destroyRetired_(bool all) {
+    if (retired.empty() && retiredSlots.empty()) return;
+    uint64_t done = UINT64_MAX;
+    if (!all) vkGetSemaphoreCounterValue(device, frameTimeline, &done);
+    size_t kept = 0;
+    for (const auto& s : retiredSlots) {
+        if (s.value > done) { retiredSlots[kept++] = s; continue; }
+        (s.texture ? freeTextures : freeMeshes).push_back(s.id);
+        meshletRanges.release(s.meshlets.firstMeshlet, s.meshlets.meshletCount);
+        meshletIndexRanges.release(s.meshlets.firstIndex, s.meshlets.indexCount);
+    }
+    retiredSlots.resize(kept);
+    kept = 0;
+    for (const auto& r : retired) {
+        if (r.value > done) { retired[kept++] = r; continue; }
+        switch (r.type) {
+            case VK_OBJECT_TYPE_BUFFER: vkDestroyBuffer(device, (VkBuffer)r.handle, nullptr); break;
+            case VK_OBJECT_TYPE_IMAGE: vkDestroyImage(device, (VkImage)r.handle, nullptr); break;
+            case VK_OBJECT_TYPE_IMAGE_VIEW: vkDestroyImageView(device, (VkImageView)r.handle, nullptr); break;
+            case VK_OBJECT_TYPE_DEVICE_MEMORY: vkFreeMemory(device, (VkDeviceMemory)r.handle, nullptr); break;
+            case VK_OBJECT_TYPE_FRAMEBUFFER: vkDestroyFramebuffer(device, (VkFramebuffer)r.handle, nullptr); break;
+            case VK_OBJECT_TYPE_PIPELINE: vkDestroyPipeline(device, (VkPipeline)r.handle, nullptr); break;
+            default: break;
+        }
+    }
+    retired.resize(kept);
+}
+
+void Engine::destroyOldSwapchains_(bool all) {
+    if (oldSwapchains.empty()) return;
+    if (all && swapchainMaintenance1) {
+        // Устройство уже простаивает, но present мог ещё не завершиться
+        for (uint32_t i = 0; i < MAX_FRAMES; ++i)
+            if (presentFencesUsed & (1u << i)) vkWaitForFences(device, 1, &presentFences[i], VK_TRUE, UINT64_MAX);
+    }
+    uint64_t done = UINT64_MAX;
+    if (!all) vkGetSemaphoreCounterValue(device, frameTimeline, &done);
+    size_t kept = 0;
+    for (auto& old : oldSwapchains) {
+        for (uint32_t i = 0; i < MAX_FRAMES; ++i)
+            if ((old.pendingFences & (1u << i)) && vkGetFenceStatus(device, presentFences[i]) == VK_SUCCESS) old.pendingFences &= ~(1u << i);
+        bool released = swapchainMaintenance1 ? old.pendingFences == 0 : old.acquiresLeft == 0;
+        if (!all && (old.value > done || !released)) { oldSwapchains[kept++] = old; continue; }
+        vkDestroySwapchainKHR(device, old.chain, nullptr);
+    }
+    oldSwapchains.resize(kept);
+}
+
+void Engine::updateSubmitToObserved_() {
+    uint64_t done = 0;
+    vkGetSemaphoreCounterValue(device, frameTimeline, &done);
+    if (done <= lastObservedFrame) return;
+    uint64_t now = CpuProfiler::nowNs();
+    // Кадры, завершённые давно, кольцо могло уже затереть — их пропускаем
+    uint64_t first = std::max(lastObservedFrame + 1, submittedFrames >= SUBMIT_RING ? submittedFrames - SUBMIT_RING + 1 : 1);
+    for (uint64_t v = first; v <= done; ++v) {
+        float ms = (float)((double)(now - submitTimes[v % SUBMIT_RING]) * 1e-6);
+        submitToObservedHistory[submitToObserved.samples % OBSERVED_WINDOW] = ms;
+        ++submitToObserved.samples;
+        submitToObserved.lastMs = ms;
+    }
+    lastObservedFrame = done;
+    uint32_t n = (uint32_t)std::min<uint64_t>(submitToObserved.samples, OBSERVED_WINDOW);
+    float sum = 0.0f, hi = 0.0f;
+    for (uint32_t i = 0; i < n; ++i) { sum += submitToObservedHistory[i]; hi = std::max(hi, submitToObservedHistory[i]); }
+    submitToObserved.avgMs = sum / (float)n;
+    submitToObserved.maxMs = hi;
+}
+
+// Копия выходного изображения в host-visible буфер слота; layout возвращается
+// обратно, так что present (или следующий кадр) его не замечает
+void Engine::recordCapture_(VkCommandBuffer cmd, uint32_t imageIndex, int slot) {
+    std::string path = std::move(pendingCapture);
+    pendingCapture.clear();
+    capturePending = false;
+    if (!swapTransferSrc) {
+        std::cerr << "frame capture: output images do not support transfer\n";
+        return;
+    }
+    captures.resize(MAX_FRAMES);
+    CaptureSlot& c = captures[slot];
+    VkDeviceSize size = (VkDeviceSize)swapExtent.width * swapExtent.height * 4;
+    if (c.size != size) {
+        if (c.buffer) { vkDestroyBuffer(device, c.buffer, nullptr); vkFreeMemory(device, c.memory, nullptr); }
+        createBuffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, c.buffer, c.memory);
+        vkMapMemory(device, c.memory, 0, size, 0, &c.mapped);
+        c.size = size;
+    }
+    c.width = swapExtent.width; c.height = swapExtent.height;
+    c.path = std::move(path);
+    c.pending = true;
+
+    VkImage image = swapImages[imageIndex];
+    VkImageLayout outLayout = getOutputLayout();
+    VkImageMemoryBarrier b{VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER};
+    b.srcQueueFamilyIndex = b.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    b.image = image; b.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+    b.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT; b.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    b.oldLayout = outLayout; b.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &b);
+    VkBufferImageCopy region{};
+    region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+    region.imageExtent = {c.width, c.height, 1};
+    vkCmdCopyImageToBuffer(cmd, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, c.buffer, 1, &region);
+    b.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT; b.dstAccessMask = 0;
+    b.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL; b.newLayout = outLayout;
+    VkBufferMemoryBarrier hb{VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER};
+    hb.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT; hb.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    hb.srcQueueFamilyIndex = hb.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    hb.buffer = c.buffer; hb.size = VK_WHOLE_SIZE;
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT | VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &hb, 1, &b);
+}
+
+void Engine::writeCapture_(CaptureSlot& c) {
+    CPU_ZONE("write capture");
+    c.pending = false;
+    std::vector<unsigned char>& rgba = lastCapture.rgba;
+    rgba.resize((size_t)c.size);
+    memcpy(rgba.data(), c.mapped, rgba.size());
+    lastCapture.width = c.width; lastCapture.height = c.height;
+    ++captureCount;
+    bool bgra = swapFormat == VK_FORMAT_B8G8R8A8_SRGB || swapFormat == VK_FORMAT_B8G8R8A8_UNORM;
+    for (size_t i = 0; i < rgba.size(); i += 4) {
+        if (bgra) std::swap(rgba[i], rgba[i + 2]);
+        rgba[i + 3] = 255;
+    }
+    if (c.path.empty()) return;
+    if (stbi_write_png(c.path.c_str(), (int)c.width, (int)c.height, 4, rgba.data(), (int)c.width * 4))
+        std::cout << "frame written to " << c.path << "\n";
+    else
+        std::cerr << "cannot write " << c.path << "\n";
+    c.path.clear();
+}
+
+void Engine::flushFrameCaptures() {
+    vkDeviceWaitIdle(device);
+    for (auto& c : captures)
+        if (c.pending) writeCapture_(c);
 }
 
 TextureHandle Engine::registerTexture_(uint32_t w, uint32_t h, const unsigned char* pixels, VkDeviceSize byteSize) {
+    if (textures.size() >= materialCapacity && freeTextures.empty()) throw std::runtime_error("material texture array is full");
     VkBuffer stagingBuf; VkDeviceMemory stagingMem;
     createBuffer(byteSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuf, stagingMem);
     void* data; vkMapMemory(device, stagingMem, 0, byteSize, 0, &data);
@@ -117,72 +406,188 @@ TextureHandle Engine::registerTexture_(uint32_t w, uint32_t h, const unsigned ch
     si.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
     si.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
     si.anisotropyEnable = VK_TRUE;
-    VkPhysicalDeviceProperties props{};
-    vkGetPhysicalDeviceProperties(physDevice, &props);
-    si.maxAnisotropy = props.limits.maxSamplerAnisotropy;
+    si.maxAnisotropy = physProps.limits.maxSamplerAnisotropy;
     si.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-    vkCreateSampler(device, &si, nullptr, &t.sampler);
-    VkDescriptorSetAllocateInfo ai{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
-    ai.descriptorPool = materialPool;
-    ai.descriptorSetCount = 1;
-    ai.pSetLayouts = &materialLayout;
-    vkAllocateDescriptorSets(device, &ai, &t.set);
+    t.sampler = getSampler(si);
+    int id = (int)textures.size();
+    if (!freeTextures.empty()) { id = freeTextures.back(); freeTextures.pop_back(); t.generation = textures[id].generation; }
     VkDescriptorImageInfo imgInfo{t.sampler, t.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
     VkWriteDescriptorSet write{VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
-    write.dstSet = t.set;
+    write.dstSet = materialSet;
     write.dstBinding = 0;
+    write.dstArrayElement = (uint32_t)id;
     write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
     write.descriptorCount = 1;
     write.pImageInfo = &imgInfo;
     vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
-    int id = (int)textures.size();
-    textures.push_back(std::move(t));
-    return TextureHandle{id};
+    if (id < (int)textures.size()) textures[id] = std::move(t);
+    else textures.push_back(std::move(t));
+    return TextureHandle{id, textures[id].generation};
+}
+
+// Дескриптор слота не трогаем: кадры в полёте ещё могут его читать, а новая
+// текстура перепишет его, только когда слот освободится
+void Engine::destroyTexture(TextureHandle h) {
+    if (!alive(h)) return;
+    TextureRes& t = textures[h.id];
+    retire(VK_OBJECT_TYPE_IMAGE_VIEW, t.view);
+    retire(VK_OBJECT_TYPE_IMAGE, t.image);
+    retire(VK_OBJECT_TYPE_DEVICE_MEMORY, t.memory);
+    t = TextureRes{};
+    t.generation = h.generation + 1;
+    retiredSlots.push_back({true, h.id, retireValue_()});
 }
 
 TextureHandle Engine::loadTexture(const std::string& path) {
+    CPU_ZONE("loadTexture");
     int w, h, ch;
     stbi_set_flip_vertically_on_load(false);
     unsigned char* pixels = stbi_load(path.c_str(), &w, &h, &ch, STBI_rgb_alpha);
     if (!pixels) return createWhiteTexture();
+    CPU_ZONE("texture upload");
     auto handle = registerTexture_((uint32_t)w, (uint32_t)h, pixels, (VkDeviceSize)w*h*4);
     stbi_image_free(pixels);
     return handle;
 }
 
 TextureHandle Engine::createWhiteTexture() {
-    if (cachedWhiteTex.valid()) return cachedWhiteTex;
+    if (alive(cachedWhiteTex)) return cachedWhiteTex;
     uint8_t white[4] = {255,255,255,255};
     cachedWhiteTex = registerTexture_(1, 1, white, 4);
     return cachedWhiteTex;
 }
 
-MeshHandle Engine::createMesh(const std::vector<Vertex>& verts, const std::vector<uint32_t>& indices) {
+// Октаэдрическая проекция единичного вектора в [-1, 1]^2
+static glm::vec2 octEncode(glm::vec3 n) {
+    float l1 = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+    if (l1 <= 0.0f) return glm::vec2(0.0f);
+    n /= l1;
+    glm::vec2 e(n.x, n.y);
+    if (n.z < 0.0f) {
+        e.x = (1.0f - std::abs(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f);
+        e.y = (1.0f - std::abs(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f);
+    }
+    return e;
+}
+
+static void packVertex(const Vertex& v, const glm::vec3& lo, const glm::vec3& extent, PackedPosition& outPos, PackedAttribs& out) {
+    glm::vec3 q = glm::clamp((v.pos - lo) / extent, 0.0f, 1.0f);
+    outPos.pos[0] = glm::packUnorm1x16(q.x);
+    outPos.pos[1] = glm::packUnorm1x16(q.y);
+    outPos.pos[2] = glm::packUnorm1x16(q.z);
+    outPos.pos[3] = 0;
+    glm::vec2 oct = octEncode(v.normal);
+    out.normal[0] = (int16_t)glm::packSnorm1x16(oct.x);
+    out.normal[1] = (int16_t)glm::packSnorm1x16(oct.y);
+    out.texCoord[0] = glm::packHalf1x16(v.texCoord.x);
+    out.texCoord[1] = glm::packHalf1x16(v.texCoord.y);
+}
+
+MeshHandle Engine::createMesh(const std::vector<Vertex>& verts, const std::vector<uint32_t>& indices,
+                              const std::vector<MeshLod>& lods, const std::vector<Meshlet>& clusters) {
+    CPU_ZONE("createMesh");
     MeshRes m;
     m.indexCount = (uint32_t)indices.size();
-    auto upload = [&](VkBufferUsageFlags usage, const void* src, VkDeviceSize sz, VkBuffer& buf, VkDeviceMemory& mem) {
-        VkBuffer sb; VkDeviceMemory sm;
-        createBuffer(sz, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT|VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, sb, sm);
-        void* p; vkMapMemory(device, sm, 0, sz, 0, &p);
-        memcpy(p, src, sz); vkUnmapMemory(device, sm);
-        createBuffer(sz, VK_BUFFER_USAGE_TRANSFER_DST_BIT|usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buf, mem);
-        copyBuffer(sb, buf, sz);
-        vkDestroyBuffer(device, sb, nullptr); vkFreeMemory(device, sm, nullptr);
-    };
-    upload(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, verts.data(), sizeof(Vertex)*verts.size(), m.vb, m.vm);
-    upload(VK_BUFFER_USAGE_INDEX_BUFFER_BIT, indices.data(), sizeof(uint32_t)*indices.size(), m.ib, m.im);
+    if (lods.empty()) {
+        m.lods[0] = {0, m.indexCount, 0.0f};
+    } else {
+        m.lodCount = (uint32_t)std::min<size_t>(lods.size(), MAX_LODS);
+        std::copy(lods.begin(), lods.begin() + m.lodCount, m.lods.begin());
+    }
+    if (!clusters.empty()) {
+        MeshletRange r;
+        r.meshletCount = (uint32_t)clusters.size();
+        r.indexCount = m.lods[0].indexCount;
+        r.firstMeshlet = meshletRanges.allocate(r.meshletCount);
+        r.firstIndex = meshletIndexRanges.allocate(r.indexCount);
+        meshlets.resize(meshletRanges.size());
+        meshletIndices.resize(meshletIndexRanges.size());
+        std::copy(indices.begin(), indices.begin() + r.indexCount, meshletIndices.begin() + r.firstIndex);
+        for (uint32_t i = 0; i < r.meshletCount; ++i) {
+            meshlets[r.firstMeshlet + i] = clusters[i];
+            meshlets[r.firstMeshlet + i].firstIndex += r.firstIndex;
+        }
+        m.firstMeshlet = r.firstMeshlet;
+        m.meshletCount = r.meshletCount;
+        m.firstMeshletIndex = r.firstIndex;
+        meshletWrites.push_back(r);
+    }
+    glm::vec3 lo(0.0f), hi(0.0f);
+    if (!verts.empty()) {
+        lo = hi = verts[0].pos;
+        for (const auto& v : verts) { lo = glm::min(lo, v.pos); hi = glm::max(hi, v.pos); }
+        glm::vec3 center = (lo + hi) * 0.5f;
+        float r2 = 0.0f;
+        for (const auto& v : verts) { glm::vec3 d = v.pos - center; r2 = std::max(r2, glm::dot(d, d)); }
+        m.bounds = glm::vec4(center, std::sqrt(r2));
+    }
+    if (vertexFormat == VertexFormat::Packed) {
+        glm::vec3 extent = glm::max(hi - lo, glm::vec3(1e-6f));
+        std::vector<PackedPosition> positions(verts.size());
+        std::vector<PackedAttribs> attribs(verts.size());
+        for (size_t i = 0; i < verts.size(); ++i) packVertex(verts[i], lo, extent, positions[i], attribs[i]);
+        m.dequant = glm::translate(glm::mat4(1.0f), lo) * glm::scale(glm::mat4(1.0f), extent);
+        uploadBuffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, positions.data(), sizeof(PackedPosition) * positions.size(), m.pb, m.pm);
+        uploadBuffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, attribs.data(), sizeof(PackedAttribs) * attribs.size(), m.vb, m.vm);
+    } else {
+        std::vector<glm::vec3> positions(verts.size());
+        std::vector<VertexAttribs> attribs(verts.size());
+        for (size_t i = 0; i < verts.size(); ++i) { positions[i] = verts[i].pos; attribs[i] = {verts[i].normal, verts[i].texCoord}; }
+        uploadBuffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, positions.data(), sizeof(glm::vec3) * positions.size(), m.pb, m.pm);
+        uploadBuffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, attribs.data(), sizeof(VertexAttribs) * attribs.size(), m.vb, m.vm);
+    }
+    uploadBuffer(VK_BUFFER_USAGE_INDEX_BUFFER_BIT, indices.data(), sizeof(uint32_t)*indices.size(), m.ib, m.im);
     int id = (int)meshes.size();
-    meshes.push_back(std::move(m));
-    return MeshHandle{id};
+    if (!freeMeshes.empty()) {
+        id = freeMeshes.back(); freeMeshes.pop_back();
+        m.generation = meshes[id].generation;
+        meshes[id] = std::move(m);
+    } else {
+        meshes.push_back(std::move(m));
+    }
+    return MeshHandle{id, meshes[id].generation};
+}
+
+void Engine::destroyMesh(MeshHandle h) {
+    if (!alive(h)) return;
+    MeshRes& m = meshes[h.id];
+    // Кластеры остаются на месте: кадры в полёте ещё могут их читать, а
+    // диапазоны освободятся вместе со слотом
+    MeshletRange clusters;
+    if (m.meshletCount > 0) clusters = {m.firstMeshlet, m.meshletCount, m.firstMeshletIndex, m.lods[0].indexCount};
+    retire(VK_OBJECT_TYPE_BUFFER, m.pb); retire(VK_OBJECT_TYPE_DEVICE_MEMORY, m.pm);
+    retire(VK_OBJECT_TYPE_BUFFER, m.vb); retire(VK_OBJECT_TYPE_DEVICE_MEMORY, m.vm);
+    retire(VK_OBJECT_TYPE_BUFFER, m.ib); retire(VK_OBJECT_TYPE_DEVICE_MEMORY, m.im);
+    m = MeshRes{};
+    m.generation = h.generation + 1;
+    retiredSlots.push_back({false, h.id, retireValue_(), clusters});
 }
 
 void Engine::createInstance_() {
     VkApplicationInfo ai{VK_STRUCTURE_TYPE_APPLICATION_INFO};
     ai.pApplicationName = "VulkanDeferred";
     ai.apiVersion = VK_API_VERSION_1_2;
-    uint32_t glfwCount;
-    const char** glfwExts = glfwGetRequiredInstanceExtensions(&glfwCount);
-    std::vector<const char*> exts(glfwExts, glfwExts + glfwCount);
+    std::vector<const char*> exts;
+    if (!headless) {
+        uint32_t glfwCount;
+        const char** glfwExts = glfwGetRequiredInstanceExtensions(&glfwCount);
+        exts.assign(glfwExts, glfwExts + glfwCount);
+#ifdef VK_EXT_swapchain_maintenance1
+        // Нужны для VK_EXT_swapchain_maintenance1 (fence на present)
+        uint32_t count = 0;
+        vkEnumerateInstanceExtensionProperties(nullptr, &count, nullptr);
+        std::vector<VkExtensionProperties> available(count);
+        vkEnumerateInstanceExtensionProperties(nullptr, &count, available.data());
+        auto has = [&](const char* name) {
+            return std::any_of(available.begin(), available.end(), [&](const VkExtensionProperties& e) { return std::strcmp(e.extensionName, name) == 0; });
+        };
+        surfaceMaintenance1 = has(VK_KHR_GET_SURFACE_CAPABILITIES_2_EXTENSION_NAME) && has(VK_EXT_SURFACE_MAINTENANCE_1_EXTENSION_NAME);
+        if (surfaceMaintenance1) {
+            exts.push_back(VK_KHR_GET_SURFACE_CAPABILITIES_2_EXTENSION_NAME);
+            exts.push_back(VK_EXT_SURFACE_MAINTENANCE_1_EXTENSION_NAME);
+        }
+#endif
+    }
     VkInstanceCreateInfo ci{VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO};
     ci.pApplicationInfo = &ai;
     ci.enabledExtensionCount = (uint32_t)exts.size();
@@ -199,12 +604,16 @@ void Engine::pickPhysDevice_() {
     vkEnumeratePhysicalDevices(instance, &cnt, nullptr);
     std::vector<VkPhysicalDevice> devs(cnt);
     vkEnumeratePhysicalDevices(instance, &cnt, devs.data());
-    physDevice = devs[0];
+    if (devs.empty()) throw std::runtime_error("No Vulkan devices (install lavapipe for CPU rendering)");
+    physDevice = cpuDeviceOnly ? VK_NULL_HANDLE : devs[0];
+    VkPhysicalDeviceType wanted = cpuDeviceOnly ? VK_PHYSICAL_DEVICE_TYPE_CPU : VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU;
     for (auto d : devs) {
         VkPhysicalDeviceProperties p;
         vkGetPhysicalDeviceProperties(d, &p);
-        if (p.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU) { physDevice = d; break; }
+        if (p.deviceType == wanted) { physDevice = d; break; }
     }
+    if (!physDevice) throw std::runtime_error("No CPU Vulkan device (install lavapipe)");
+    vkGetPhysicalDeviceProperties(physDevice, &physProps);
 }
 
 void Engine::createDevice_() {
@@ -215,8 +624,10 @@ void Engine::createDevice_() {
     graphicsFamily = presentFamily = UINT32_MAX;
     for (uint32_t i = 0; i < qfCount; ++i) {
         if (qf[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) graphicsFamily = i;
+        // Headless: «present» — та же графическая очередь
         VkBool32 pres = VK_FALSE;
-        vkGetPhysicalDeviceSurfaceSupportKHR(physDevice, i, surface, &pres);
+        if (headless) pres = (qf[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) ? VK_TRUE : VK_FALSE;
+        else vkGetPhysicalDeviceSurfaceSupportKHR(physDevice, i, surface, &pres);
         if (pres) presentFamily = i;
         if (graphicsFamily != UINT32_MAX && presentFamily != UINT32_MAX) break;
     }
@@ -228,15 +639,78 @@ void Engine::createDevice_() {
         qi.queueFamilyIndex = f; qi.queueCount = 1; qi.pQueuePriorities = &prio;
         qcis.push_back(qi);
     }
+    // Без обязательных возможностей устройство не создаётся: лучше понятная
+    // ошибка здесь, чем VK_ERROR_FEATURE_NOT_PRESENT или UB на драйвере
+    VkPhysicalDeviceVulkan12Features supported12{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES};
+    VkPhysicalDeviceFeatures2 supported2{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2};
+    supported2.pNext = &supported12;
+    vkGetPhysicalDeviceFeatures2(physDevice, &supported2);
+    const VkPhysicalDeviceFeatures& supported = supported2.features;
+    std::string missing;
+    auto require = [&](VkBool32 has, const char* name) {
+        if (!has) missing += missing.empty() ? name : std::string(", ") + name;
+    };
+    require(supported.samplerAnisotropy, "samplerAnisotropy");
+    require(supported.shaderSampledImageArrayDynamicIndexing, "shaderSampledImageArrayDynamicIndexing");
+    require(supported12.descriptorIndexing, "descriptorIndexing");
+    require(supported12.runtimeDescriptorArray, "runtimeDescriptorArray");
+    require(supported12.descriptorBindingPartiallyBound, "descriptorBindingPartiallyBound");
+    require(supported12.descriptorBindingSampledImageUpdateAfterBind, "descriptorBindingSampledImageUpdateAfterBind");
+    require(supported12.descriptorBindingUpdateUnusedWhilePending, "descriptorBindingUpdateUnusedWhilePending");
+    require(supported12.timelineSemaphore, "timelineSemaphore");
+    if (!missing.empty()) throw std::runtime_error("Vulkan device lacks required features: " + missing);
+
     VkPhysicalDeviceFeatures features{};
     features.samplerAnisotropy = VK_TRUE;
+    features.shaderSampledImageArrayDynamicIndexing = VK_TRUE;
+    // Статистика конвейера для GpuProfiler — только если устройство её умеет
+    features.pipelineStatisticsQuery = supported.pipelineStatisticsQuery;
+    pipelineStatsSupported = supported.pipelineStatisticsQuery == VK_TRUE;
+    // Bindless-массив текстур материалов
+    VkPhysicalDeviceVulkan12Features features12{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES};
+    features12.descriptorIndexing = VK_TRUE;
+    features12.runtimeDescriptorArray = VK_TRUE;
+    features12.descriptorBindingPartiallyBound = VK_TRUE;
+    features12.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+    // Текстуры грузятся и освобождаются, пока кадры с набором ещё в полёте
+    features12.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+    // Синхронизация кадров (обязательна в Vulkan 1.2)
+    features12.timelineSemaphore = VK_TRUE;
+    std::vector<const char*> extensions = kDeviceExtensions;
+#ifdef VK_EXT_swapchain_maintenance1
+    // Fence на present: по нему освобождается старая цепочка при пересоздании
+    VkPhysicalDeviceSwapchainMaintenance1FeaturesEXT maintenance1{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SWAPCHAIN_MAINTENANCE_1_FEATURES_EXT};
+    if (!headless && surfaceMaintenance1) {
+        uint32_t count = 0;
+        vkEnumerateDeviceExtensionProperties(physDevice, nullptr, &count, nullptr);
+        std::vector<VkExtensionProperties> available(count);
+        vkEnumerateDeviceExtensionProperties(physDevice, nullptr, &count, available.data());
+        bool hasExt = std::any_of(available.begin(), available.end(), [](const VkExtensionProperties& e) {
+            return std::strcmp(e.extensionName, VK_EXT_SWAPCHAIN_MAINTENANCE_1_EXTENSION_NAME) == 0;
+        });
+        if (hasExt) {
+            VkPhysicalDeviceFeatures2 query{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2};
+            query.pNext = &maintenance1;
+            vkGetPhysicalDeviceFeatures2(physDevice, &query);
+            swapchainMaintenance1 = maintenance1.swapchainMaintenance1 == VK_TRUE;
+        }
+        if (swapchainMaintenance1) {
+            extensions.push_back(VK_EXT_SWAPCHAIN_MAINTENANCE_1_EXTENSION_NAME);
+            maintenance1.pNext = features12.pNext;
+            features12.pNext = &maintenance1;
+        }
+    }
+#endif
     VkDeviceCreateInfo ci{VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO};
+    ci.pNext = &features12;
     ci.queueCreateInfoCount = (uint32_t)qcis.size();
     ci.pQueueCreateInfos = qcis.data();
-    ci.enabledExtensionCount = (uint32_t)kDeviceExtensions.size();
-    ci.ppEnabledExtensionNames = kDeviceExtensions.data();
+    // Headless не использует swapchain и не требует его расширения
+    ci.enabledExtensionCount = headless ? 0 : (uint32_t)extensions.size();
+    ci.ppEnabledExtensionNames = extensions.data();
     ci.pEnabledFeatures = &features;
-    vkCreateDevice(physDevice, &ci, nullptr, &device);
+    VkResult res = vkCreateDevice(physDevice, &ci, nullptr, &device);
+    if (res != VK_SUCCESS) throw std::runtime_error("vkCreateDevice failed: VkResult " + std::to_string(res));
     vkGetDeviceQueue(device, graphicsFamily, 0, &graphicsQueue);
     vkGetDeviceQueue(device, presentFamily, 0, &presentQueue);
 }
@@ -250,13 +724,14 @@ void Engine::createSwapchain_() {
     vkGetPhysicalDeviceSurfaceFormatsKHR(physDevice, surface, &fmtCnt, fmts.data());
     uint32_t pmCnt;
     vkGetPhysicalDeviceSurfacePresentModesKHR(physDevice, surface, &pmCnt, nullptr);
-    std::vector<VkPresentModeKHR> pms(pmCnt);
-    vkGetPhysicalDeviceSurfacePresentModesKHR(physDevice, surface, &pmCnt, pms.data());
+    supportedPresentModes.resize(pmCnt);
+    vkGetPhysicalDeviceSurfacePresentModesKHR(physDevice, surface, &pmCnt, supportedPresentModes.data());
     VkSurfaceFormatKHR fmt = fmts[0];
     for (auto& f : fmts)
         if (f.format == VK_FORMAT_B8G8R8A8_SRGB && f.colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR) { fmt = f; break; }
-    VkPresentModeKHR pm = VK_PRESENT_MODE_FIFO_KHR;
-    for (auto m : pms) if (m == VK_PRESENT_MODE_MAILBOX_KHR) { pm = m; break; }
+    // FIFO поддерживается всегда
+    VkPresentModeKHR pm = isPresentModeSupported(requestedPresentMode) ? requestedPresentMode : VK_PRESENT_MODE_FIFO_KHR;
+    presentMode = pm;
 
     if (caps.currentExtent.width != UINT32_MAX) {
         swapExtent = caps.currentExtent;
@@ -266,7 +741,7 @@ void Engine::createSwapchain_() {
         swapExtent.height = std::clamp((uint32_t)h, caps.minImageExtent.height, caps.maxImageExtent.height);
     }
 
-    uint32_t imgCnt = caps.minImageCount + 1;
+    uint32_t imgCnt = requestedImageCount ? std::max(requestedImageCount, caps.minImageCount) : caps.minImageCount + 1;
     if (caps.maxImageCount > 0) imgCnt = std::min(imgCnt, caps.maxImageCount);
     VkSwapchainCreateInfoKHR ci{VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR};
     ci.surface = surface;
@@ -276,6 +751,9 @@ void Engine::createSwapchain_() {
     ci.imageExtent = swapExtent;
     ci.imageArrayLayers = 1;
     ci.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+    // Для снимков кадра (requestFrameCapture)
+    swapTransferSrc = (caps.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) != 0;
+    if (swapTransferSrc) ci.imageUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
     uint32_t families[] = {graphicsFamily, presentFamily};
     if (graphicsFamily != presentFamily) {
         ci.imageSharingMode = VK_SHARING_MODE_CONCURRENT;
@@ -288,6 +766,9 @@ void Engine::createSwapchain_() {
     ci.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
     ci.presentMode = pm;
     ci.clipped = VK_TRUE;
+    // Драйвер может передать ресурсы старой цепочки новой, а кадры старой
+    // спокойно досчитываются и показываются
+    ci.oldSwapchain = swapchain;
     vkCreateSwapchainKHR(device, &ci, nullptr, &swapchain);
     swapFormat = fmt.format;
     vkGetSwapchainImagesKHR(device, swapchain, &imgCnt, nullptr);
@@ -314,59 +795,118 @@ void Engine::createCommandBuffers_() {
     vkAllocateCommandBuffers(device, &ai, commandBuffers.data());
 }
 
+// Вместо swapchain: по изображению на кадр в полёте, в sRGB как и окно
+void Engine::createOffscreenTargets_() {
+    swapFormat = VK_FORMAT_R8G8B8A8_SRGB;
+    swapImages.resize(MAX_FRAMES);
+    offscreenMemory.resize(MAX_FRAMES);
+    swapImageViews.resize(MAX_FRAMES);
+    for (int i = 0; i < MAX_FRAMES; ++i) {
+        createImage(swapExtent.width, swapExtent.height, 1, swapFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, swapImages[i], offscreenMemory[i]);
+        swapImageViews[i] = createImageView(swapImages[i], swapFormat, VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, VK_IMAGE_VIEW_TYPE_2D);
+    }
+    swapTransferSrc = true;
+}
+
 void Engine::createSyncObjects_() {
     imageAvailable.resize(MAX_FRAMES);
     renderFinished.resize(MAX_FRAMES);
-    inFlightFences.resize(MAX_FRAMES);
-    imagesInFlight.resize(swapImages.size(), VK_NULL_HANDLE);
+    imageValues.assign(swapImages.size(), 0);
     VkSemaphoreCreateInfo si{VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
-    VkFenceCreateInfo fi{VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
-    fi.flags = VK_FENCE_CREATE_SIGNALED_BIT;
     for (int i = 0; i < MAX_FRAMES; ++i) {
         vkCreateSemaphore(device, &si, nullptr, &imageAvailable[i]);
         vkCreateSemaphore(device, &si, nullptr, &renderFinished[i]);
-        vkCreateFence(device, &fi, nullptr, &inFlightFences[i]);
+    }
+    VkSemaphoreTypeCreateInfo ti{VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO};
+    ti.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    ti.initialValue = 0;
+    si.pNext = &ti;
+    vkCreateSemaphore(device, &si, nullptr, &frameTimeline);
+    if (swapchainMaintenance1) {
+        VkFenceCreateInfo fi{VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
+        for (auto& f : presentFences) vkCreateFence(device, &fi, nullptr, &f);
     }
 }
 
+// Один массив sampler2D на все текстуры: дескриптор пишется при загрузке
+// текстуры, набор привязывается один раз на проход. Размер ограничен только
+// лимитами устройства для update-after-bind.
 void Engine::createMaterialLayout_() {
+    VkPhysicalDeviceVulkan12Properties props12{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES};
+    VkPhysicalDeviceProperties2 props{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2};
+    props.pNext = &props12;
+    vkGetPhysicalDeviceProperties2(physDevice, &props);
+    materialCapacity = std::min({MAX_MATERIAL_TEXTURES,
+                                 props12.maxPerStageDescriptorUpdateAfterBindSamplers,
+                                 props12.maxPerStageDescriptorUpdateAfterBindSampledImages,
+                                 props12.maxDescriptorSetUpdateAfterBindSamplers,
+                                 props12.maxDescriptorSetUpdateAfterBindSampledImages});
     VkDescriptorSetLayoutBinding b{};
     b.binding = 0;
     b.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-    b.descriptorCount = 1;
+    b.descriptorCount = materialCapacity;
     b.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+    VkDescriptorBindingFlags flags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+    VkDescriptorSetLayoutBindingFlagsCreateInfo fci{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO};
+    fci.bindingCount = 1;
+    fci.pBindingFlags = &flags;
     VkDescriptorSetLayoutCreateInfo ci{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+    ci.pNext = &fci;
+    ci.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
     ci.bindingCount = 1;
     ci.pBindings = &b;
     vkCreateDescriptorSetLayout(device, &ci, nullptr, &materialLayout);
 }
 
 void Engine::createMaterialPool_() {
-    VkDescriptorPoolSize ps{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2048};
+    VkDescriptorPoolSize ps{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, materialCapacity};
     VkDescriptorPoolCreateInfo ci{VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
+    ci.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
     ci.poolSizeCount = 1;
     ci.pPoolSizes = &ps;
-    ci.maxSets = 2048;
+    ci.maxSets = 1;
     vkCreateDescriptorPool(device, &ci, nullptr, &materialPool);
+    VkDescriptorSetAllocateInfo ai{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
+    ai.descriptorPool = materialPool;
+    ai.descriptorSetCount = 1;
+    ai.pSetLayouts = &materialLayout;
+    vkAllocateDescriptorSets(device, &ai, &materialSet);
 }
 
 void Engine::cleanupSwapchain_() {
     for (auto iv : swapImageViews) vkDestroyImageView(device, iv, nullptr);
     swapImageViews.clear();
+    if (headless) {
+        for (size_t i = 0; i < swapImages.size(); ++i) {
+            vkDestroyImage(device, swapImages[i], nullptr);
+            vkFreeMemory(device, offscreenMemory[i], nullptr);
+        }
+        swapImages.clear(); offscreenMemory.clear();
+        return;
+    }
     vkDestroySwapchainKHR(device, swapchain, nullptr);
 }
 
 void Engine::recreateSwapchain() {
+    if (headless) return; // размер задаётся в initHeadless и не меняется
     int w = 0, h = 0;
     glfwGetFramebufferSize(window, &w, &h);
     while (w == 0 || h == 0) {
         glfwGetFramebufferSize(window, &w, &h);
         glfwWaitEvents();
     }
-    vkDeviceWaitIdle(device);
-    cleanupSwapchain_();
+    // Без ожидания устройства: виды удаляются, когда завершатся уже
+    // отправленные кадры, сама цепочка — ещё и после их present
+    VkSwapchainKHR old = swapchain;
+    for (auto iv : swapImageViews) retire(VK_OBJECT_TYPE_IMAGE_VIEW, iv);
+    swapImageViews.clear();
     createSwapchain_();
-    imagesInFlight.assign(swapImages.size(), VK_NULL_HANDLE);
+    // Счёт acquire начинается заново на новой цепочке — и для прежних старых тоже
+    uint32_t acquires = (uint32_t)swapImages.size() + 1;
+    for (auto& o : oldSwapchains) o.acquiresLeft = acquires;
+    oldSwapchains.push_back({old, submittedFrames, presentFencesUsed, acquires});
+    swapchainDirty = false;
+    imageValues.assign(swapImages.size(), 0);
 }
 
 uint32_t Engine::findMemoryType(uint32_t filter, VkMemoryPropertyFlags flags) const {
@@ -386,6 +926,239 @@ VkFormat Engine::findDepthFormat() const {
     return VK_FORMAT_UNDEFINED;
 }
 
+// Кэш лежит в пользовательском каталоге кэшей, а не в рабочем каталоге:
+// %LOCALAPPDATA%, $XDG_CACHE_HOME или ~/.cache. Без них — рядом с программой.
+static std::filesystem::path pipelineCacheDir() {
+#ifdef _WIN32
+    const char* base = std::getenv("LOCALAPPDATA");
+    if (base && *base) return std::filesystem::path(base) / "VulkanDeferred";
+#else
+    const char* base = std::getenv("XDG_CACHE_HOME");
+    if (base && *base) return std::filesystem::path(base) / "VulkanDeferred";
+    const char* home = std::getenv("HOME");
+    if (home && *home) return std::filesystem::path(home) / ".cache" / "VulkanDeferred";
+#endif
+    return ".";
+}
+
+static constexpr const char* PIPELINE_CACHE_PREFIX = "pipeline_cache_";
+
+// Данные кэша годятся только для того же устройства и драйвера,
+// поэтому они входят в имя файла
+std::string Engine::pipelineCachePath_() const {
+    char uuid[2 * VK_UUID_SIZE + 1];
+    for (int i = 0; i < VK_UUID_SIZE; ++i) snprintf(uuid + 2 * i, 3, "%02x", physProps.pipelineCacheUUID[i]);
+    std::string name = PIPELINE_CACHE_PREFIX + std::string(uuid) + "_" + std::to_string(physProps.driverVersion) + ".bin";
+    return (pipelineCacheDir() / name).string();
+}
+
+void Engine::createPipelineCache_() {
+    std::vector<char> data;
+    if (pipelineCacheEnabled) {
+        std::ifstream f(pipelineCachePath_(), std::ios::binary | std::ios::ate);
+        if (f.is_open()) {
+            data.resize((size_t)f.tellg());
+            f.seekg(0);
+            f.read(data.data(), data.size());
+        }
+    }
+    // Заголовок: размер, версия, vendorID, deviceID, UUID кэша
+    if (!data.empty()) {
+        uint32_t header[4] = {};
+        bool ok = data.size() >= 16 + VK_UUID_SIZE;
+        if (ok) {
+            memcpy(header, data.data(), sizeof(header));
+            ok = header[0] >= 16 + VK_UUID_SIZE && header[0] <= data.size()
+              && header[1] == VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+              && header[2] == physProps.vendorID && header[3] == physProps.deviceID
+              && memcmp(data.data() + 16, physProps.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+        }
+        if (!ok) {
+            std::cerr << "pipeline cache: header mismatch, starting cold\n";
+            data.clear();
+        }
+    }
+    VkPipelineCacheCreateInfo ci{VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO};
+    ci.initialDataSize = data.size();
+    ci.pInitialData = data.empty() ? nullptr : data.data();
+    if (vkCreatePipelineCache(device, &ci, nullptr, &pipelineCache) != VK_SUCCESS && !data.empty()) {
+        // Драйвер отверг данные — начинаем с пустого кэша
+        ci.initialDataSize = 0; ci.pInitialData = nullptr;
+        data.clear();
+        vkCreatePipelineCache(device, &ci, nullptr, &pipelineCache);
+    }
+    pipelineCacheWarm = !data.empty();
+    std::cout << "pipeline cache: " << (pipelineCacheWarm ? "warm, " + std::to_string(data.size()) + " bytes" : std::string("cold")) << "\n";
+}
+
+void Engine::savePipelineCache_() {
+    if (!pipelineCacheEnabled || pipelineCache == VK_NULL_HANDLE) return;
+    size_t size = 0;
+    vkGetPipelineCacheData(device, pipelineCache, &size, nullptr);
+    std::vector<char> data(size);
+    if (size == 0 || vkGetPipelineCacheData(device, pipelineCache, &size, data.data()) != VK_SUCCESS) return;
+    namespace fs = std::filesystem;
+    fs::path path = pipelineCachePath_();
+    std::error_code ec;
+    fs::create_directories(path.parent_path(), ec);
+    // Пишем во временный файл и подменяем им старый, чтобы не оставить обрезанный кэш
+    fs::path tmp = path;
+    tmp += ".tmp";
+    {
+        std::ofstream f(tmp, std::ios::binary | std::ios::trunc);
+        if (!f.write(data.data(), (std::streamsize)size)) return;
+    }
+#ifdef _WIN32
+    // std::rename на Windows не перезаписывает существующий файл
+    bool replaced = MoveFileExW(tmp.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    bool replaced = std::rename(tmp.c_str(), path.c_str()) == 0;
+#endif
+    if (!replaced) {
+        std::cerr << "pipeline cache: failed to replace " << path.string() << "\n";
+        fs::remove(tmp, ec);
+        return;
+    }
+    // Кэши прошлых драйверов и устройств больше не прочитаются
+    std::error_code removeEc;
+    for (fs::directory_iterator it(path.parent_path(), ec), end; !ec && it != end; it.increment(ec)) {
+        std::string name = it->path().filename().string();
+        if (it->path() != path && name.rfind(PIPELINE_CACHE_PREFIX, 0) == 0 && it->path().extension() == ".bin")
+            fs::remove(it->path(), removeEc);
+    }
+}
+
+VkShaderModule Engine::getShaderModule(const std::string& path) {
+    auto it = shadersByName.find(path);
+    if (it != shadersByName.end()) return it->second;
+
+    const char* code = nullptr;
+    const char* archived = nullptr;
+    size_t size = 0;
+    std::vector<char> fileData;
+    std::string name = path.substr(path.find_last_of("/\\") + 1);
+    auto entry = shaderArchiveIndex.find(name);
+    if (entry != shaderArchiveIndex.end()) {
+        code = archived = shaderArchiveData + entry->second.offset;
+        size = entry->second.size;
+    } else {
+        fileData = readFile(path);
+        code = fileData.data();
+        size = fileData.size();
+    }
+    if (size == 0 || size % 4 != 0) throw std::runtime_error("Invalid SPIR-V: " + path);
+
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < size; ++i) hash = (hash ^ (unsigned char)code[i]) * 1099511628211ull;
+    VkShaderModule module = VK_NULL_HANDLE;
+    auto [first, last] = shadersByHash.equal_range(hash);
+    for (auto e = first; e != last; ++e) {
+        const ShaderEntry& known = e->second;
+        if (known.size == size && std::memcmp(known.bytes(), code, size) == 0) { module = known.module; break; }
+    }
+    if (module == VK_NULL_HANDLE) {
+        VkShaderModuleCreateInfo ci{VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO};
+        ci.codeSize = size;
+        ci.pCode = reinterpret_cast<const uint32_t*>(code);
+        if (vkCreateShaderModule(device, &ci, nullptr, &module) != VK_SUCCESS) throw std::runtime_error("Failed to create shader module: " + path);
+        ShaderEntry known{module, archived, size, {}};
+        if (!archived) known.code = std::move(fileData);
+        shadersByHash.emplace(hash, std::move(known));
+    }
+    shadersByName.emplace(path, module);
+    return module;
+}
+
+void Engine::invalidateShader(const std::string& path) {
+    shaderArchiveIndex.erase(path.substr(path.find_last_of("/\\") + 1));
+    auto it = shadersByName.find(path);
+    if (it == shadersByName.end()) return;
+    VkShaderModule module = it->second;
+    shadersByName.erase(it);
+    // Модуль мог быть общим с другим именем. Созданным конвейерам модули
+    // не нужны, так что ничей модуль удаляется сразу, без ожидания кадров
+    for (const auto& [name, m] : shadersByName)
+        if (m == module) return;
+    for (auto e = shadersByHash.begin(); e != shadersByHash.end(); ++e)
+        if (e->second.module == module) {
+            vkDestroyShaderModule(device, module, nullptr);
+            shadersByHash.erase(e);
+            return;
+        }
+}
+
+// Формат архива — см. cmake/PackShaders.cmake
+bool Engine::loadShaderArchive(const std::string& path) {
+    closeShaderArchive_();
+    const char* base = nullptr;
+    size_t size = 0;
+#ifndef _WIN32
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st{};
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        void* p = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED) {
+            shaderArchiveMapping = p;
+            shaderArchiveMappingSize = (size_t)st.st_size;
+            base = static_cast<const char*>(p);
+            size = shaderArchiveMappingSize;
+        }
+    }
+    close(fd);
+#endif
+    if (!base) {
+        std::ifstream f(path, std::ios::binary | std::ios::ate);
+        if (!f.is_open()) return false;
+        shaderArchiveCopy.resize((size_t)f.tellg());
+        f.seekg(0);
+        f.read(shaderArchiveCopy.data(), shaderArchiveCopy.size());
+        base = shaderArchiveCopy.data();
+        size = shaderArchiveCopy.size();
+    }
+
+    std::string text(base, std::min<size_t>(size, 64 * 1024));
+    size_t end = text.find("\nEND");
+    size_t headerEnd = end == std::string::npos ? std::string::npos : text.find('\n', end + 1);
+    if (text.compare(0, 9, "SPVPAK 1\n") != 0 || headerEnd == std::string::npos) {
+        std::cerr << "shader archive " << path << ": bad header\n";
+        closeShaderArchive_();
+        return false;
+    }
+    std::istringstream index(text.substr(9, end - 8));
+    std::string name;
+    size_t offset, length;
+    size_t dataSize = size - (headerEnd + 1);
+    while (index >> name >> offset >> length) {
+        if (offset + length > dataSize) {
+            std::cerr << "shader archive " << path << ": entry " << name << " out of range\n";
+            closeShaderArchive_();
+            return false;
+        }
+        shaderArchiveIndex[name] = {offset, length};
+    }
+    shaderArchiveData = base + headerEnd + 1;
+    return true;
+}
+
+void Engine::closeShaderArchive_() {
+    // Модули из архива переживают его: для сравнения им нужна своя копия кода
+    for (auto& [hash, entry] : shadersByHash)
+        if (entry.archived) {
+            entry.code.assign(entry.archived, entry.archived + entry.size);
+            entry.archived = nullptr;
+        }
+#ifndef _WIN32
+    if (shaderArchiveMapping) munmap(shaderArchiveMapping, shaderArchiveMappingSize);
+#endif
+    shaderArchiveMapping = nullptr;
+    shaderArchiveMappingSize = 0;
+    shaderArchiveCopy.clear();
+    shaderArchiveCopy.shrink_to_fit();
+    shaderArchiveIndex.clear();
+    shaderArchiveData = nullptr;
+}
+
 std::vector<char> Engine::readFile(const std::string& path) const {
     std::ifstream f(path, std::ios::binary | std::ios::ate);
     if (!f.is_open()) {
@@ -398,6 +1171,35 @@ std::vector<char> Engine::readFile(const std::string& path) const {
     return buf;
 }
 
+VkSampler Engine::getSampler(const VkSamplerCreateInfo& info) {
+    SamplerKey key;
+    memset(&key.info, 0, sizeof(key.info));
+    key.info.flags = info.flags;
+    key.info.magFilter = info.magFilter;
+    key.info.minFilter = info.minFilter;
+    key.info.mipmapMode = info.mipmapMode;
+    key.info.addressModeU = info.addressModeU;
+    key.info.addressModeV = info.addressModeV;
+    key.info.addressModeW = info.addressModeW;
+    key.info.mipLodBias = info.mipLodBias;
+    key.info.anisotropyEnable = info.anisotropyEnable;
+    key.info.maxAnisotropy = info.anisotropyEnable ? info.maxAnisotropy : 0.0f;
+    key.info.compareEnable = info.compareEnable;
+    key.info.compareOp = info.compareEnable ? info.compareOp : VK_COMPARE_OP_NEVER;
+    key.info.minLod = info.minLod;
+    key.info.maxLod = info.maxLod;
+    key.info.borderColor = info.borderColor;
+    key.info.unnormalizedCoordinates = info.unnormalizedCoordinates;
+    auto it = samplers.find(key);
+    if (it != samplers.end()) return it->second;
+    VkSamplerCreateInfo ci = key.info;
+    ci.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+    VkSampler sampler = VK_NULL_HANDLE;
+    if (vkCreateSampler(device, &ci, nullptr, &sampler) != VK_SUCCESS) throw std::runtime_error("failed to create sampler");
+    samplers.emplace(key, sampler);
+    return sampler;
+}
+
 void Engine::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags props, VkBuffer& buf, VkDeviceMemory& mem) {
     VkBufferCreateInfo ci{VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO};
     ci.size = size; ci.usage = usage; ci.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
@@ -411,6 +1213,17 @@ void Engine::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryP
     vkBindBufferMemory(device, buf, mem, 0);
 }
 
+void Engine::uploadBuffer(VkBufferUsageFlags usage, const void* data, VkDeviceSize size, VkBuffer& buf, VkDeviceMemory& mem) {
+    CPU_ZONE("uploadBuffer");
+    VkBuffer sb; VkDeviceMemory sm;
+    createBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT|VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, sb, sm);
+    void* p; vkMapMemory(device, sm, 0, size, 0, &p);
+    memcpy(p, data, size); vkUnmapMemory(device, sm);
+    createBuffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT|usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buf, mem);
+    copyBuffer(sb, buf, size);
+    vkDestroyBuffer(device, sb, nullptr); vkFreeMemory(device, sm, nullptr);
+}
+
 void Engine::copyBuffer(VkBuffer src, VkBuffer dst, VkDeviceSize size) {
     VkCommandBuffer cmd = beginSingleTime();
     VkBufferCopy region{0, 0, size};
@@ -436,7 +1249,10 @@ void Engine::endSingleTime(VkCommandBuffer cmd) {
     VkSubmitInfo si{VK_STRUCTURE_TYPE_SUBMIT_INFO};
     si.commandBufferCount = 1; si.pCommandBuffers = &cmd;
     vkQueueSubmit(graphicsQueue, 1, &si, VK_NULL_HANDLE);
-    vkQueueWaitIdle(graphicsQueue);
+    {
+        CPU_ZONE("single-time wait");
+        vkQueueWaitIdle(graphicsQueue);
+    }
     vkFreeCommandBuffers(device, commandPool, 1, &cmd);
 }
 
@@ -3,33 +3,90 @@
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
 #include <vector>
 #include <string>
 #include <array>
+#include <algorithm>
+#include <unordered_map>
+#include <cstring>
+#include "GpuProfiler.h"
+#include "RangeAllocator.h"
 
 struct Vertex {
     glm::vec3 pos;
     glm::vec3 normal;
     glm::vec2 texCoord;
+};
 
-    static VkVertexInputBindingDescription getBindingDesc() {
-        VkVertexInputBindingDescription d{};
-        d.binding = 0;
-        d.stride = sizeof(Vertex);
-        d.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-        return d;
-    }
-    static std::array<VkVertexInputAttributeDescription, 3> getAttrDescs() {
-        std::array<VkVertexInputAttributeDescription, 3> a{};
-        a[0] = {0, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, pos)};
-        a[1] = {1, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, normal)};
-        a[2] = {2, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(Vertex, texCoord)};
-        return a;
+enum class VertexFormat { Full, Packed };
+
+// На GPU вершина лежит двумя потоками: binding 0 — только позиции (их читают
+// проходы глубины и теней), binding 1 — нормаль и UV.
+struct VertexAttribs {
+    glm::vec3 normal;
+    glm::vec2 texCoord;
+};
+
+// Сжатый формат, 16 байт вместо 32. Позиция квантована в AABB меша
+// (unorm16, деквантование вшито в матрицу модели), нормаль — октаэдрическая
+// проекция в snorm16x2, UV — half float.
+struct PackedPosition {
+    uint16_t pos[4];
+};
+struct PackedAttribs {
+    int16_t normal[2];
+    uint16_t texCoord[2];
+};
+
+struct VertexLayout {
+    std::array<VkVertexInputBindingDescription, 2> bindings{};
+    std::array<VkVertexInputAttributeDescription, 3> attrs{};
+
+    static VertexLayout get(VertexFormat fmt) {
+        VertexLayout l;
+        bool packed = fmt == VertexFormat::Packed;
+        l.bindings[0] = {0, packed ? (uint32_t)sizeof(PackedPosition) : (uint32_t)sizeof(glm::vec3), VK_VERTEX_INPUT_RATE_VERTEX};
+        l.bindings[1] = {1, packed ? (uint32_t)sizeof(PackedAttribs) : (uint32_t)sizeof(VertexAttribs), VK_VERTEX_INPUT_RATE_VERTEX};
+        if (packed) {
+            l.attrs[0] = {0, 0, VK_FORMAT_R16G16B16A16_UNORM, 0};
+            l.attrs[1] = {1, 1, VK_FORMAT_R16G16_SNORM, offsetof(PackedAttribs, normal)};
+            l.attrs[2] = {2, 1, VK_FORMAT_R16G16_SFLOAT, offsetof(PackedAttribs, texCoord)};
+        } else {
+            l.attrs[0] = {0, 0, VK_FORMAT_R32G32B32_SFLOAT, 0};
+            l.attrs[1] = {1, 1, VK_FORMAT_R32G32B32_SFLOAT, offsetof(VertexAttribs, normal)};
+            l.attrs[2] = {2, 1, VK_FORMAT_R32G32_SFLOAT, offsetof(VertexAttribs, texCoord)};
+        }
+        return l;
     }
 };
 
-struct TextureHandle { int id = -1; bool valid() const { return id >= 0; } };
-struct MeshHandle { int id = -1; bool valid() const { return id >= 0; } };
+// Диапазон индексов одного LOD в общем индексном буфере меша
+struct MeshLod {
+    uint32_t firstIndex = 0;
+    uint32_t indexCount = 0;
+    float error = 0.0f; // геометрическая ошибка относительно LOD0, в единицах модели
+};
+
+// Кластер треугольников для GPU-отсечения. Раскладка совпадает с std430 в cull.comp.
+struct Meshlet {
+    glm::vec4 sphere{0.0f};      // центр + радиус в пространстве модели
+    glm::vec4 cone{0, 0, 1, 1};  // ось + cutoff; cutoff = 1 — конус не отсекает
+    uint32_t firstIndex = 0;     // в индексах LOD0 меша
+    uint32_t indexCount = 0;
+    uint32_t pad[2] = {};
+};
+
+// Диапазоны одного меша в общих массивах кластеров и их индексов
+struct MeshletRange {
+    uint32_t firstMeshlet = 0, meshletCount = 0;
+    uint32_t firstIndex = 0, indexCount = 0;
+};
+
+// generation растёт при каждом destroy слота: хэндл, переживший destroy,
+// не попадёт в ресурс, занявший слот после него (см. Engine::alive)
+struct TextureHandle { int id = -1; uint32_t generation = 0; bool valid() const { return id >= 0; } };
+struct MeshHandle { int id = -1; uint32_t generation = 0; bool valid() const { return id >= 0; } };
 
 struct SubMesh {
     MeshHandle mesh;
@@ -39,19 +96,18 @@ struct SubMesh {
 
 struct SceneObject {
     std::vector<SubMesh> submeshes;
-    glm::mat4 transform = glm::mat4(1.0f);
+    glm::vec3 position = glm::vec3(0.0f);
+    glm::quat rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+    glm::vec3 scale = glm::vec3(1.0f);
     bool animatable = false;
     int animFrame = 0;
     bool unlit = false;
     glm::vec4 unlitColor = {1,1,1,1};
+};
 
-    void nextAnimFrame() {
-        if (!animatable) return;
-        ++animFrame;
-        for (auto& sm : submeshes)
-            if (!sm.animTextures.empty())
-                sm.texture = sm.animTextures[animFrame % (int)sm.animTextures.size()];
-    }
+struct CapturedImage {
+    uint32_t width = 0, height = 0;
+    std::vector<unsigned char> rgba;
 };
 
 struct FrameContext {
@@ -63,17 +119,85 @@ struct FrameContext {
 
 class Engine {
 public:
-    static constexpr int MAX_FRAMES = 2;
+    // Предел кадров в полёте: ресурсы на кадр заводятся под него, а сколько
+    // слотов реально в ходу — setFramesInFlight
+    static constexpr int MAX_FRAMES = 4;
+    static constexpr int MAX_LODS = 4;
+    static constexpr uint32_t MAX_MATERIAL_TEXTURES = 65536;
 
+    // Кэш пайплайнов на диске; выключается до init (для замеров холодного старта)
+    void setPipelineCacheEnabled(bool enabled) { pipelineCacheEnabled = enabled; }
+    // Только программное устройство (lavapipe) вместо предпочтения дискретного;
+    // до init. Эталонные кадры рисуются им, чтобы не зависеть от GPU машины
+    void setCpuDeviceOnly(bool enabled) { cpuDeviceOnly = enabled; }
     void init(GLFWwindow* window);
+    // Без окна и поверхности: кадры рисуются в собственные изображения
+    // (по одному на кадр в полёте), present нет. Работает и на lavapipe.
+    void initHeadless(uint32_t width, uint32_t height);
     void cleanup();
     FrameContext beginFrame();
     void endFrame(const FrameContext& ctx);
     void recreateSwapchain();
+    bool isHeadless() const { return headless; }
+    // 1..MAX_FRAMES, меняется между кадрами. Меньше — ниже задержка ввода,
+    // больше — CPU и GPU реже ждут друг друга
+    void setFramesInFlight(int count) { framesInFlight = std::clamp(count, 1, MAX_FRAMES); }
+    int getFramesInFlight() const { return framesInFlight; }
+    // Режим present и число изображений swapchain (0 — minImageCount + 1).
+    // Применяются пересозданием swapchain: ближайший beginFrame вернёт
+    // невалидный кадр, как при смене размера. Неподдерживаемый режим
+    // заменяется FIFO, число изображений зажимается в пределы поверхности.
+    void setPresentMode(VkPresentModeKHR mode);
+    void setSwapImageCount(uint32_t count);
+    VkPresentModeKHR getPresentMode() const { return presentMode; } // фактический
+    bool isPresentModeSupported(VkPresentModeKHR mode) const;
+    // От vkQueueSubmit до момента, когда CPU заметил завершение кадра на GPU.
+    // Это не задержка GPU: опрос идёт только в beginFrame, так что в число
+    // входит и ожидание CPU до следующего кадра
+    struct SubmitToObservedStats {
+        float lastMs = 0.0f, avgMs = 0.0f, maxMs = 0.0f; // avg/max — по OBSERVED_WINDOW кадрам
+        uint64_t samples = 0;
+    };
+    static constexpr uint32_t OBSERVED_WINDOW = 120;
+    const SubmitToObservedStats& getSubmitToObserved() const { return submitToObserved; }
+    // Отложенное удаление без ожидания устройства: объект уничтожается в
+    // beginFrame, когда GPU завершит все кадры, отправленные до вызова, и
+    // кадр, записываемый в момент вызова.
+    // Типы: buffer, image, image view, device memory, framebuffer, pipeline.
+    // Swapchain сюда не годится: завершение present timeline не отражает.
+    template <typename Handle>
+    void retire(VkObjectType type, Handle handle) { if (handle) retire_(type, (uint64_t)handle); }
+    // Layout, в котором проход освещения оставляет выходное изображение
+    VkImageLayout getOutputLayout() const { return headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR; }
+
+    // Следующий endFrame копирует выходное изображение в буфер; снимок
+    // разбирается, когда кадр завершён (в beginFrame того же слота или во
+    // flushFrameCaptures). Пустой путь — PNG не пишется, только getLastCapture.
+    void requestFrameCapture(const std::string& pngPath) { capturePending = true; pendingCapture = pngPath; }
+    void flushFrameCaptures();
+    // Последний разобранный снимок, RGBA8 (sRGB), альфа = 255
+    const CapturedImage& getLastCapture() const { return lastCapture; }
+    uint64_t getCaptureCount() const { return captureCount; }
 
     TextureHandle loadTexture(const std::string& path);
     TextureHandle createWhiteTexture();
-    MeshHandle createMesh(const std::vector<Vertex>& verts, const std::vector<uint32_t>& indices);
+    // indices — все LOD подряд; пустой lods означает один LOD на весь буфер.
+    // meshlets (необязательно) покрывают индексы LOD0.
+    MeshHandle createMesh(const std::vector<Vertex>& verts, const std::vector<uint32_t>& indices,
+                          const std::vector<MeshLod>& lods = {}, const std::vector<Meshlet>& meshlets = {});
+    // Ресурсы уходят в retire, слот хэндла возвращается в свободный список,
+    // когда GPU закончит уже отправленные кадры (и записываемый, если вызов
+    // пришёлся между beginFrame и endFrame), — до этого новый меш или
+    // текстура его не получат. После вызова хэндл нельзя использовать в новых
+    // кадрах: геттеры и отрисовка такой хэндл отвергают.
+    void destroyMesh(MeshHandle h);
+    void destroyTexture(TextureHandle h);
+    bool alive(MeshHandle h) const { return mesh_(h) != nullptr; }
+    bool alive(TextureHandle h) const { return h.valid() && h.id < (int)textures.size() && textures[h.id].generation == h.generation && textures[h.id].image; }
+
+    // Формат задаётся до загрузки мешей и создания пайплайнов
+    void setVertexFormat(VertexFormat fmt) { vertexFormat = fmt; }
+    VertexFormat getVertexFormat() const { return vertexFormat; }
 
     VkDevice getDevice() const { return device; }
     VkPhysicalDevice getPhysDevice() const { return physDevice; }
@@ -86,16 +210,49 @@ public:
     const std::vector<VkImageView>& getSwapImageViews() const { return swapImageViews; }
     size_t getSwapImageCount() const { return swapImages.size(); }
 
+    // Bindless: индекс текстуры в массиве материалов совпадает с id хэндла
     VkDescriptorSetLayout getMaterialLayout() const { return materialLayout; }
-    VkDescriptorSet getTextureSet(TextureHandle h) const { return (h.valid()) ? textures[h.id].set : VK_NULL_HANDLE; }
-
-    void bindAndDrawMesh_(VkCommandBuffer cmd, MeshHandle h) const {
-        if (!h.valid()) return;
-        const auto& m = meshes[h.id];
-        VkDeviceSize offset = 0;
-        vkCmdBindVertexBuffers(cmd, 0, 1, &m.vb, &offset);
-        vkCmdBindIndexBuffer(cmd, m.ib, 0, VK_INDEX_TYPE_UINT32);
-        vkCmdDrawIndexed(cmd, m.indexCount, 1, 0, 0, 0);
+    VkDescriptorSet getMaterialSet() const { return materialSet; }
+    // Устаревший или пустой хэндл — индекс белой текстуры (0, если её нет)
+    uint32_t getMaterialIndex(TextureHandle h) const {
+        if (alive(h)) return (uint32_t)h.id;
+        return alive(cachedWhiteTex) ? (uint32_t)cachedWhiteTex.id : 0;
+    }
+    // Геттеры мешей на устаревший хэндл отвечают как на пустой меш
+    glm::vec4 getMeshBounds(MeshHandle h) const { const MeshRes* m = mesh_(h); return m ? m->bounds : glm::vec4(0.0f); }
+    // Переводит квантованные позиции в пространство модели; для Full — единичная
+    const glm::mat4& getMeshDequant(MeshHandle h) const { const MeshRes* m = mesh_(h); return m ? m->dequant : EMPTY_MESH.dequant; }
+    uint32_t getMeshLodCount(MeshHandle h) const { const MeshRes* m = mesh_(h); return m ? m->lodCount : 0; }
+    const MeshLod& getMeshLod(MeshHandle h, uint32_t lod) const { const MeshRes* m = mesh_(h); return m ? m->lods[lod] : EMPTY_MESH.lods[0]; }
+
+    // Кластеры всех мешей лежат в одном массиве; их индексы продублированы
+    // в общий массив для compute-отсечения (firstIndex указывает в него).
+    // Диапазоны раздаются из свободных списков и не сдвигаются: удалённый меш
+    // освобождает свои, когда GPU закончит кадры, которые могли их читать.
+    uint32_t getFirstMeshlet(MeshHandle h) const { const MeshRes* m = mesh_(h); return m ? m->firstMeshlet : 0; }
+    uint32_t getMeshletCount(MeshHandle h) const { const MeshRes* m = mesh_(h); return m ? m->meshletCount : 0; }
+    const std::vector<Meshlet>& getMeshlets() const { return meshlets; }
+    const std::vector<uint32_t>& getMeshletIndices() const { return meshletIndices; }
+    // Забирает диапазоны, записанные createMesh с прошлого вызова, — их
+    // нужно дописать в копию массивов на GPU
+    void takeMeshletWrites(std::vector<MeshletRange>& out) { out.swap(meshletWrites); meshletWrites.clear(); }
+
+    void bindAndDrawMesh_(VkCommandBuffer cmd, MeshHandle h, bool positionsOnly = false, uint32_t lod = 0) const {
+        const MeshRes* m = mesh_(h);
+        if (!m) return;
+        const MeshLod& l = m->lods[std::min(lod, m->lodCount - 1)];
+        bindMeshVertices_(cmd, *m, positionsOnly);
+        vkCmdBindIndexBuffer(cmd, m->ib, 0, VK_INDEX_TYPE_UINT32);
+        vkCmdDrawIndexed(cmd, l.indexCount, 1, l.firstIndex, 0, 0);
+    }
+
+    // Индексы и число индексов берутся из буферов отсечения кластеров
+    void bindAndDrawMeshIndirect_(VkCommandBuffer cmd, MeshHandle h, VkBuffer indexBuf, VkBuffer drawBuf, VkDeviceSize drawOffset) const {
+        const MeshRes* m = mesh_(h);
+        if (!m) return;
+        bindMeshVertices_(cmd, *m, false);
+        vkCmdBindIndexBuffer(cmd, indexBuf, 0, VK_INDEX_TYPE_UINT32);
+        vkCmdDrawIndexedIndirect(cmd, drawBuf, drawOffset, 1, sizeof(VkDrawIndexedIndirectCommand));
     }
 
     uint32_t findMemoryType(uint32_t filter, VkMemoryPropertyFlags flags) const;
@@ -104,6 +261,8 @@ public:
 
     void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags props, VkBuffer& buf, VkDeviceMemory& mem);
     void copyBuffer(VkBuffer src, VkBuffer dst, VkDeviceSize size);
+    // Device-local буфер с данными через staging
+    void uploadBuffer(VkBufferUsageFlags usage, const void* data, VkDeviceSize size, VkBuffer& buf, VkDeviceMemory& mem);
 
     VkCommandBuffer beginSingleTime();
     void endSingleTime(VkCommandBuffer cmd);
@@ -115,10 +274,30 @@ public:
     VkImageView createImageView(VkImage img, VkFormat fmt, VkImageAspectFlags aspect, uint32_t baseLayer, uint32_t layerCount, VkImageViewType viewType) const;
     VkShaderModule createShaderModule(const std::vector<char>& code) const;
 
+    // Библиотека шейдеров: каждый SPIR-V грузится один раз, одинаковый код
+    // (хэш, затем побайтовое сравнение) даёт один модуль. Модули принадлежат Engine
+    // и живут до cleanup или invalidateShader.
+    // Если загружен архив, шейдер ищется в нём по имени файла.
+    VkShaderModule getShaderModule(const std::string& path);
+    bool loadShaderArchive(const std::string& path);
+    // Следующий getShaderModule(path) перечитает файл с диска мимо библиотеки и
+    // архива. Старый модуль удаляется, если на него не ссылается другое имя.
+    void invalidateShader(const std::string& path);
+
+    // Семплеры дедуплицируются по содержимому VkSamplerCreateInfo (pNext не
+    // поддерживается) и живут до Engine::cleanup — вызывающий их не удаляет
+    VkSampler getSampler(const VkSamplerCreateInfo& info);
+    size_t getSamplerCount() const { return samplers.size(); }
+    const VkPhysicalDeviceProperties& getPhysProps() const { return physProps; }
+    VkPipelineCache getPipelineCache() const { return pipelineCache; }
+    bool isPipelineCacheWarm() const { return pipelineCacheWarm; }
+    GpuProfiler& getGpuProfiler() { return gpuProfiler; }
+
 private:
     GLFWwindow* window = nullptr;
     VkInstance instance = VK_NULL_HANDLE;
     VkPhysicalDevice physDevice = VK_NULL_HANDLE;
+    VkPhysicalDeviceProperties physProps{};
     VkDevice device = VK_NULL_HANDLE;
     VkQueue graphicsQueue = VK_NULL_HANDLE;
     VkQueue presentQueue = VK_NULL_HANDLE;
@@ -131,45 +310,197 @@ private:
     std::vector<VkImageView> swapImageViews;
     VkFormat swapFormat = VK_FORMAT_UNDEFINED;
     VkExtent2D swapExtent = {};
+    VkPresentModeKHR requestedPresentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+    VkPresentModeKHR presentMode = VK_PRESENT_MODE_FIFO_KHR;
+    std::vector<VkPresentModeKHR> supportedPresentModes;
+    uint32_t requestedImageCount = 0;
+    bool swapchainDirty = false; // настройки present поменялись, нужен recreateSwapchain
+    // Старая цепочка живёт, пока presentation engine не отпустит её изображения.
+    // С VK_EXT_swapchain_maintenance1 — до сигнала fence каждого её present.
+    // Без него — пока новая цепочка не отдаст imageCount + 1 изображений:
+    // present идут по порядку, а повторный acquire изображения значит, что
+    // его прошлый present, а с ним и все более ранние, уже показан.
+    struct OldSwapchain {
+        VkSwapchainKHR chain;
+        uint64_t value;          // кадр timeline, после которого GPU её не трогает
+        uint32_t pendingFences;  // маска слотов presentFences
+        uint32_t acquiresLeft;
+    };
+    std::vector<OldSwapchain> oldSwapchains;
+    bool surfaceMaintenance1 = false; // инстанс-расширения, нужные swapchain_maintenance1
+    bool swapchainMaintenance1 = false;
+    std::array<VkFence, MAX_FRAMES> presentFences{};
+    uint32_t presentFencesUsed = 0; // слоты, чей fence отдан present и ещё не сброшен
 
     VkCommandPool commandPool = VK_NULL_HANDLE;
     std::vector<VkCommandBuffer> commandBuffers;
     std::vector<VkSemaphore> imageAvailable;
     std::vector<VkSemaphore> renderFinished;
-    std::vector<VkFence> inFlightFences;
-    std::vector<VkFence> imagesInFlight;
+    // Timeline: значение N — завершён N-й отправленный кадр
+    VkSemaphore frameTimeline = VK_NULL_HANDLE;
+    uint64_t submittedFrames = 0;
+    bool frameOpen = false; // beginFrame вернул валидный кадр, endFrame ещё не вызван
+    std::array<uint64_t, MAX_FRAMES> slotValues{}; // последний кадр, записанный в слот
+    std::vector<uint64_t> imageValues;             // последний кадр, рисовавший в изображение swapchain
     int currentFrame = 0;
+    int framesInFlight = 2;
+
+    // Время отправки кадров, ещё не замеченных завершёнными; кольцо больше
+    // MAX_FRAMES, потому что кадр завершается не раньше следующего beginFrame
+    static constexpr uint32_t SUBMIT_RING = MAX_FRAMES * 2;
+    std::array<uint64_t, SUBMIT_RING> submitTimes{};
+    uint64_t lastObservedFrame = 0; // последний учтённый кадр
+    std::array<float, OBSERVED_WINDOW> submitToObservedHistory{};
+    SubmitToObservedStats submitToObserved;
+
+    struct RetiredObject {
+        VkObjectType type;
+        uint64_t handle;
+        uint64_t value; // последний кадр, который мог его использовать
+    };
+    std::vector<RetiredObject> retired;
+    struct RetiredSlot {
+        bool texture; // иначе меш
+        int id;
+        uint64_t value;
+        MeshletRange meshlets; // у меша — диапазоны кластеров для возврата в свободные списки
+    };
+    std::vector<RetiredSlot> retiredSlots;
+    std::vector<int> freeMeshes, freeTextures;
+
+    bool headless = false;
+    bool swapTransferSrc = false;             // выходные изображения можно копировать
+    std::vector<VkDeviceMemory> offscreenMemory; // headless: память выходных изображений
+
+    struct CaptureSlot {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        void* mapped = nullptr;
+        VkDeviceSize size = 0;
+        uint32_t width = 0, height = 0;
+        std::string path;
+        bool pending = false; // копия записана и ждёт завершения кадра
+    };
+    std::vector<CaptureSlot> captures;
+    bool capturePending = false;
+    std::string pendingCapture;
+    CapturedImage lastCapture;
+    uint64_t captureCount = 0;
 
     struct TextureRes {
         VkImage image = VK_NULL_HANDLE;
         VkDeviceMemory memory = VK_NULL_HANDLE;
         VkImageView view = VK_NULL_HANDLE;
-        VkSampler sampler = VK_NULL_HANDLE;
-        VkDescriptorSet set = VK_NULL_HANDLE;
+        VkSampler sampler = VK_NULL_HANDLE; // из кэша семплеров
+        uint32_t generation = 0;
     };
     struct MeshRes {
-        VkBuffer vb = VK_NULL_HANDLE, ib = VK_NULL_HANDLE;
-        VkDeviceMemory vm = VK_NULL_HANDLE, im = VK_NULL_HANDLE;
+        VkBuffer pb = VK_NULL_HANDLE, vb = VK_NULL_HANDLE, ib = VK_NULL_HANDLE;
+        VkDeviceMemory pm = VK_NULL_HANDLE, vm = VK_NULL_HANDLE, im = VK_NULL_HANDLE;
         uint32_t indexCount = 0;
+        std::array<MeshLod, MAX_LODS> lods{};
+        uint32_t lodCount = 1;
+        uint32_t firstMeshlet = 0, meshletCount = 0;
+        uint32_t firstMeshletIndex = 0; // начало индексов кластеров в meshletIndices
+        glm::vec4 bounds{0.0f};
+        glm::mat4 dequant{1.0f};
+        uint32_t generation = 0;
     };
+    static const MeshRes EMPTY_MESH; // ответ геттеров на устаревший хэндл
     std::vector<TextureRes> textures;
     std::vector<MeshRes> meshes;
+    std::vector<Meshlet> meshlets;
+    std::vector<uint32_t> meshletIndices;
+    RangeAllocator meshletRanges, meshletIndexRanges;
+    std::vector<MeshletRange> meshletWrites;
     TextureHandle cachedWhiteTex;
+    VertexFormat vertexFormat = VertexFormat::Full;
+
+    // Ключ — VkSamplerCreateInfo с обнулёнными sType/pNext и паддингом
+    struct SamplerKey {
+        VkSamplerCreateInfo info;
+        bool operator==(const SamplerKey& o) const { return memcmp(&info, &o.info, sizeof(info)) == 0; }
+    };
+    struct SamplerKeyHash {
+        size_t operator()(const SamplerKey& k) const {
+            const auto* bytes = reinterpret_cast<const unsigned char*>(&k.info);
+            size_t h = 14695981039346656037ull;
+            for (size_t i = 0; i < sizeof(k.info); ++i) h = (h ^ bytes[i]) * 1099511628211ull;
+            return h;
+        }
+    };
+    std::unordered_map<SamplerKey, VkSampler, SamplerKeyHash> samplers;
+
+    std::unordered_map<std::string, VkShaderModule> shadersByName;
+    // Код нужен для побайтового сравнения: совпадение хэша ещё не равенство.
+    // У шейдеров из архива это указатель в отображённый файл, копия не хранится
+    struct ShaderEntry {
+        VkShaderModule module;
+        const char* archived; // nullptr — код лежит в code
+        size_t size;
+        std::vector<char> code;
+        const char* bytes() const { return archived ? archived : code.data(); }
+    };
+    std::unordered_multimap<uint64_t, ShaderEntry> shadersByHash;
+    struct ArchiveEntry { size_t offset, size; };
+    std::unordered_map<std::string, ArchiveEntry> shaderArchiveIndex;
+    const char* shaderArchiveData = nullptr; // начало данных после индекса
+    void* shaderArchiveMapping = nullptr;
+    size_t shaderArchiveMappingSize = 0;
+    std::vector<char> shaderArchiveCopy;     // если отображение в память недоступно
+
+    VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+    bool pipelineCacheEnabled = true;
+    bool cpuDeviceOnly = false;
+    bool pipelineCacheWarm = false;
+
+    GpuProfiler gpuProfiler;
+    bool pipelineStatsSupported = false;
 
     VkDescriptorPool materialPool = VK_NULL_HANDLE;
     VkDescriptorSetLayout materialLayout = VK_NULL_HANDLE;
+    VkDescriptorSet materialSet = VK_NULL_HANDLE;
+    uint32_t materialCapacity = 0;
 
     void createInstance_();
     void createSurface_(GLFWwindow* w);
     void pickPhysDevice_();
     void createDevice_();
+    void init_();
+    // Текущий swapchain (если есть) уходит в oldSwapchain; удалять его — вызывающему
     void createSwapchain_();
+    void createOffscreenTargets_();
+    void waitFrame_(uint64_t value);
+    void updateSubmitToObserved_();
+    // Между beginFrame и endFrame объект может попасть в записываемый кадр,
+    // который получит значение submittedFrames + 1
+    uint64_t retireValue_() const { return submittedFrames + (frameOpen ? 1 : 0); }
+    void retire_(VkObjectType type, uint64_t handle) { retired.push_back({type, handle, retireValue_()}); }
+    void destroyRetired_(bool all);
+    void destroyOldSwapchains_(bool all);
+    void recordCapture_(VkCommandBuffer cmd, uint32_t imageIndex, int slot);
+    void writeCapture_(CaptureSlot& c);
     void createCommandPool_();
     void createCommandBuffers_();
     void createSyncObjects_();
     void createMaterialLayout_();
     void createMaterialPool_();
     void cleanupSwapchain_();
+    std::string pipelineCachePath_() const;
+    void createPipelineCache_();
+    void savePipelineCache_();
+    void closeShaderArchive_();
+
+    const MeshRes* mesh_(MeshHandle h) const {
+        if (!h.valid() || h.id >= (int)meshes.size()) return nullptr;
+        const MeshRes& m = meshes[h.id];
+        return (m.generation == h.generation && m.ib) ? &m : nullptr;
+    }
+    void bindMeshVertices_(VkCommandBuffer cmd, const MeshRes& m, bool positionsOnly) const {
+        VkBuffer bufs[2] = {m.pb, m.vb};
+        VkDeviceSize offsets[2] = {0, 0};
+        vkCmdBindVertexBuffers(cmd, 0, positionsOnly ? 1 : 2, bufs, offsets);
+    }
 
     TextureHandle registerTexture_(uint32_t w, uint32_t h, const unsigned char* pixels, VkDeviceSize size);
 };
@@ -0,0 +1,29 @@
+#include "FrameLimiter.h"
+#include "CpuProfiler.h"
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+void FrameLimiter::setTargetFps(double fps) {
+    targetFps = std::max(fps, 0.0);
+    periodNs = targetFps > 0.0 ? (uint64_t)(1.0e9 / targetFps) : 0;
+    deadlineNs = 0;
+}
+
+void FrameLimiter::wait() {
+    if (periodNs == 0) return;
+    CPU_ZONE("frame limiter");
+    uint64_t now = CpuProfiler::nowNs();
+    // Отставание больше кадра не догоняем пачкой коротких кадров
+    deadlineNs = (deadlineNs == 0 || now > deadlineNs + periodNs) ? now + periodNs : deadlineNs + periodNs;
+    // Спим короткими отрезками, пока до дедлайна больше ожидаемого пересыпа
+    while (true) {
+        now = CpuProfiler::nowNs();
+        if (now >= deadlineNs || (double)(deadlineNs - now) <= oversleepNs + 2.0e5) break;
+        const uint64_t requested = 1000000;
+        std::this_thread::sleep_for(std::chrono::nanoseconds(requested));
+        double actual = (double)(CpuProfiler::nowNs() - now);
+        oversleepNs = 0.9 * oversleepNs + 0.1 * std::max(actual - (double)requested, 0.0);
+    }
+    while (CpuProfiler::nowNs() < deadlineNs) std::this_thread::yield();
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include <cstdint>
+
+// Ограничение частоты кадров: спим до дедлайна с запасом, остаток добираем
+// активным ожиданием. Запас подстраивается под фактический пересып
+// планировщика, поэтому на спин уходит доля миллисекунды, а не целое ядро.
+class FrameLimiter {
+public:
+    // 0 — без ограничения
+    void setTargetFps(double fps);
+    double getTargetFps() const { return targetFps; }
+    // Вызывается раз в кадр, после endFrame
+    void wait();
+
+private:
+    double targetFps = 0.0;
+    uint64_t periodNs = 0;
+    uint64_t deadlineNs = 0;
+    double oversleepNs = 1.0e6; // скользящая оценка пересыпа, стартуем с 1 мс
+};
@@ -1,10 +1,18 @@
 #include "GBuffer.h"
 #include "Engine.h"
+#include <algorithm>
+
+// Запас ~1/8 с выравниванием на 64: растягивание окна мышью не пересоздаёт
+// вложения на каждом шаге
+static uint32_t withHeadroom(uint32_t size, uint32_t limit) {
+    return std::min((size + size / 8 + 63) & ~63u, std::max(limit, size));
+}
 
 void GBuffer::init(Engine& engine, uint32_t width, uint32_t height) {
     extent = {width, height};
+    capacity = extent;
     createAttachments_(engine);
-    createSampler_(engine.getDevice());
+    createSampler_(engine);
     createRenderPass_(engine);
     createFramebuffer_(engine);
 }
@@ -12,36 +20,39 @@ void GBuffer::init(Engine& engine, uint32_t width, uint32_t height) {
 void GBuffer::cleanup(VkDevice device) {
     vkDestroyFramebuffer(device, framebuffer, nullptr); framebuffer = VK_NULL_HANDLE;
     vkDestroyRenderPass(device, renderPass, nullptr); renderPass = VK_NULL_HANDLE;
-    vkDestroySampler(device, sampler, nullptr); sampler = VK_NULL_HANDLE;
+    sampler = VK_NULL_HANDLE; // принадлежит кэшу семплеров Engine
     destroyAttachments_(device);
 }
 
-void GBuffer::recreate(Engine& engine, uint32_t width, uint32_t height) {
-    vkDeviceWaitIdle(engine.getDevice());
-    VkDevice dev = engine.getDevice();
-    vkDestroyFramebuffer(dev, framebuffer, nullptr);
-    destroyAttachments_(dev);
+bool GBuffer::recreate(Engine& engine, uint32_t width, uint32_t height) {
     extent = {width, height};
+    bool fits = width <= capacity.width && height <= capacity.height;
+    // Окно, уменьшившееся в несколько раз, отдаёт лишнюю память
+    bool wasteful = (uint64_t)width * height * 4 < (uint64_t)capacity.width * capacity.height;
+    if (fits && !wasteful) return false;
+    engine.retire(VK_OBJECT_TYPE_FRAMEBUFFER, framebuffer);
+    retireAttachments_(engine);
+    const VkPhysicalDeviceLimits& limits = engine.getPhysProps().limits;
+    capacity = {withHeadroom(width, limits.maxFramebufferWidth), withHeadroom(height, limits.maxFramebufferHeight)};
     createAttachments_(engine);
     createFramebuffer_(engine);
+    return true;
 }
 
 void GBuffer::createAttachments_(Engine& engine) {
     constexpr VkFormat fmts[NUM_ATTACHMENTS] = { FORMAT_NORMAL, FORMAT_ALBEDO };
     for (int i = 0; i < NUM_ATTACHMENTS; ++i) {
-        engine.createImage(extent.width, extent.height, 1, fmts[i], VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, images[i], memories[i]);
+        engine.createImage(capacity.width, capacity.height, 1, fmts[i], VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, images[i], memories[i]);
         views[i] = engine.createImageView(images[i], fmts[i], VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, VK_IMAGE_VIEW_TYPE_2D);
-        engine.transitionLayout(images[i], 1, fmts[i], VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
     }
     VkFormat depthFmt = engine.findDepthFormat();
 
     // ВАЖНО: Добавляем VK_IMAGE_USAGE_SAMPLED_BIT к Depth Buffer, чтобы читать его в шейдере освещения
-    engine.createImage(extent.width, extent.height, 1, depthFmt, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, depthImage, depthMemory);
+    engine.createImage(capacity.width, capacity.height, 1, depthFmt, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, depthImage, depthMemory);
     depthView = engine.createImageView(depthImage, depthFmt, VK_IMAGE_ASPECT_DEPTH_BIT, 0, 1, VK_IMAGE_VIEW_TYPE_2D);
-    engine.transitionLayout(depthImage, 1, depthFmt, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
 }
 
-void GBuffer::createSampler_(VkDevice device) {
+void GBuffer::createSampler_(Engine& engine) {
     if (sampler != VK_NULL_HANDLE) return;
     VkSamplerCreateInfo si{VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO};
     si.magFilter = VK_FILTER_NEAREST;
@@ -50,7 +61,7 @@ void GBuffer::createSampler_(VkDevice device) {
     si.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
     si.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
     si.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
-    vkCreateSampler(device, &si, nullptr, &sampler);
+    sampler = engine.getSampler(si);
 }
 
 void GBuffer::createRenderPass_(Engine& engine) {
@@ -62,7 +73,9 @@ void GBuffer::createRenderPass_(Engine& engine) {
     for (int i = 0; i < NUM_ATTACHMENTS; ++i) {
         atts[i].format = fmts[i]; atts[i].samples = VK_SAMPLE_COUNT_1_BIT; atts[i].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR; atts[i].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
         atts[i].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE; atts[i].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-        atts[i].initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL; atts[i].finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        // Вложения очищаются, так что прошлое содержимое не нужно — и отдельный
+        // переход layout при создании тоже
+        atts[i].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED; atts[i].finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
     }
 
     // Настраиваем RenderPass так, чтобы по окончании он переводил Depth Buffer в режим ЧТЕНИЯ (SHADER_READ_ONLY)
@@ -100,7 +113,7 @@ void GBuffer::createFramebuffer_(Engine& engine) {
     std::array<VkImageView, 3> attachments = {views[0], views[1], depthView};
     VkFramebufferCreateInfo fci{VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO};
     fci.renderPass = renderPass; fci.attachmentCount = (uint32_t)attachments.size(); fci.pAttachments = attachments.data();
-    fci.width = extent.width; fci.height = extent.height; fci.layers = 1;
+    fci.width = capacity.width; fci.height = capacity.height; fci.layers = 1;
     vkCreateFramebuffer(engine.getDevice(), &fci, nullptr, &framebuffer);
 }
 
@@ -112,3 +125,12 @@ void GBuffer::destroyAttachments_(VkDevice device) {
     vkDestroyImageView(device, depthView, nullptr); vkDestroyImage(device, depthImage, nullptr); vkFreeMemory(device, depthMemory, nullptr);
     depthView = VK_NULL_HANDLE; depthImage = VK_NULL_HANDLE; depthMemory = VK_NULL_HANDLE;
 }
+
+void GBuffer::retireAttachments_(Engine& engine) {
+    for (int i = 0; i < NUM_ATTACHMENTS; ++i) {
+        engine.retire(VK_OBJECT_TYPE_IMAGE_VIEW, views[i]); engine.retire(VK_OBJECT_TYPE_IMAGE, images[i]); engine.retire(VK_OBJECT_TYPE_DEVICE_MEMORY, memories[i]);
+        views[i] = VK_NULL_HANDLE; images[i] = VK_NULL_HANDLE; memories[i] = VK_NULL_HANDLE;
+    }
+    engine.retire(VK_OBJECT_TYPE_IMAGE_VIEW, depthView); engine.retire(VK_OBJECT_TYPE_IMAGE, depthImage); engine.retire(VK_OBJECT_TYPE_DEVICE_MEMORY, depthMemory);
+    depthView = VK_NULL_HANDLE; depthImage = VK_NULL_HANDLE; depthMemory = VK_NULL_HANDLE;
+}
@@ -14,7 +14,10 @@ public:
 
     void init(Engine& engine, uint32_t width, uint32_t height);
     void cleanup(VkDevice device);
-    void recreate(Engine& engine, uint32_t width, uint32_t height);
+    // Без ожидания устройства. Вложения выделяются с запасом: если новый
+    // размер в них помещается, меняется только область отрисовки. Иначе старые
+    // уходят в Engine::retire. true — виды вложений поменялись.
+    bool recreate(Engine& engine, uint32_t width, uint32_t height);
 
     VkRenderPass getRenderPass() const { return renderPass; }
     VkFramebuffer getFramebuffer() const { return framebuffer; }
@@ -25,10 +28,12 @@ public:
     VkImageView getDepthView()  const { return depthView; }
 
     VkSampler getSampler() const { return sampler; }
-    VkExtent2D getExtent() const { return extent; }
+    VkExtent2D getExtent() const { return extent; }     // область отрисовки
+    VkExtent2D getCapacity() const { return capacity; } // размер вложений и framebuffer
 
 private:
     VkExtent2D extent{};
+    VkExtent2D capacity{};
     std::array<VkImage, NUM_ATTACHMENTS> images{};
     std::array<VkDeviceMemory, NUM_ATTACHMENTS> memories{};
     std::array<VkImageView, NUM_ATTACHMENTS> views{};
@@ -42,6 +47,7 @@ private:
     void createAttachments_(Engine& engine);
     void createRenderPass_(Engine& engine);
     void createFramebuffer_(Engine& engine);
-    void createSampler_(VkDevice device);
+    void createSampler_(Engine& engine);
     void destroyAttachments_(VkDevice device);
+    void retireAttachments_(Engine& engine);
 };
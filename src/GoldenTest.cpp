@@ -0,0 +1,172 @@
+#include "GoldenTest.h"
+#include <stb_image.h>
+#include <stb_image_write.h>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+
+namespace GoldenImage {
+
+bool load(const std::string& path, CapturedImage& out) {
+    int w = 0, h = 0, ch = 0;
+    unsigned char* pixels = stbi_load(path.c_str(), &w, &h, &ch, STBI_rgb_alpha);
+    if (!pixels) return false;
+    out.width = (uint32_t)w; out.height = (uint32_t)h;
+    out.rgba.assign(pixels, pixels + (size_t)w * h * 4);
+    stbi_image_free(pixels);
+    return true;
+}
+
+bool save(const std::string& path, const CapturedImage& image) {
+    std::filesystem::path dir = std::filesystem::path(path).parent_path();
+    std::error_code ec;
+    if (!dir.empty()) std::filesystem::create_directories(dir, ec);
+    return stbi_write_png(path.c_str(), (int)image.width, (int)image.height, 4, image.rgba.data(), (int)image.width * 4) != 0;
+}
+
+Result compare(const CapturedImage& reference, const CapturedImage& actual, int tolerance, CapturedImage* diff) {
+    Result r;
+    if (reference.width != actual.width || reference.height != actual.height) {
+        r.sizeMatch = false;
+        return r;
+    }
+    size_t pixels = (size_t)reference.width * reference.height;
+    if (diff) { diff->width = reference.width; diff->height = reference.height; diff->rgba.resize(pixels * 4); }
+    double sqSum = 0.0;
+    size_t bad = 0;
+    for (size_t p = 0; p < pixels; ++p) {
+        const unsigned char* a = &reference.rgba[p * 4];
+        const unsigned char* b = &actual.rgba[p * 4];
+        int worst = 0;
+        for (int c = 0; c < 3; ++c) {
+            int d = std::abs((int)a[c] - (int)b[c]);
+            sqSum += (double)d * d;
+            worst = std::max(worst, d);
+        }
+        r.maxDiff = std::max(r.maxDiff, worst);
+        bad += worst > tolerance;
+        if (!diff) continue;
+        unsigned char* o = &diff->rgba[p * 4];
+        if (worst > tolerance) {
+            o[0] = 255; o[1] = o[2] = 0;
+        } else {
+            // Серый фон из эталона, мелкие отличия чуть подсвечены
+            unsigned char g = (unsigned char)((a[0] * 77 + a[1] * 150 + a[2] * 29) >> 10);
+            o[0] = o[1] = o[2] = g;
+            o[0] = (unsigned char)std::min(255, o[0] + worst * 16);
+        }
+        o[3] = 255;
+    }
+    double mse = pixels ? sqSum / (double)(pixels * 3) : 0.0;
+    r.psnr = mse > 0.0 ? 10.0 * std::log10(255.0 * 255.0 / mse) : std::numeric_limits<double>::infinity();
+    r.badFraction = pixels ? (double)bad / (double)pixels : 0.0;
+    return r;
+}
+
+} // namespace GoldenImage
+
+// Ракурсы по Sponza: неф, галерея, сверху; отдельно ядро PCF и точечные источники
+std::vector<GoldenCase> GoldenRunner::defaultCases() {
+    return {
+        {"nave",        {-11.0f, 1.8f,  0.0f},    0.0f,   0.0f, 0.0f, 1, 0},
+        {"nave-pcf5x5", {-11.0f, 1.8f,  0.0f},    0.0f,   0.0f, 0.0f, 2, 0},
+        {"nave-hard",   {-11.0f, 1.8f,  0.0f},    0.0f,   0.0f, 0.0f, 0, 0},
+        {"gallery",     {  8.0f, 6.5f, -3.5f},  180.0f, -15.0f, 2.0f, 1, 0},
+        {"flashlights", {  0.0f, 3.0f,  6.0f},  -90.0f, -30.0f, 1.0f, 1, 6},
+        {"overview",    {  0.0f, 12.0f, 0.0f},  -90.0f, -80.0f, 3.0f, 1, 0},
+    };
+}
+
+void GoldenRunner::init(std::vector<GoldenCase> list, const Options& options) {
+    cases = std::move(list);
+    opts = options;
+    opts.framesPerCase = std::max<uint32_t>(opts.framesPerCase, Engine::MAX_FRAMES + 1);
+    results.assign(cases.size(), CaseResult{});
+}
+
+void GoldenRunner::addCpu(uint64_t frame, double ms) {
+    if (!measured_(frame)) return;
+    CaseResult& r = results[caseIndex_(frame)];
+    r.cpuMs += ms;
+    ++r.cpuFrames;
+}
+
+void GoldenRunner::addGpu(uint64_t frame, double ms) {
+    if (!measured_(frame)) return;
+    CaseResult& r = results[caseIndex_(frame)];
+    r.gpuMs += ms;
+    ++r.gpuFrames;
+}
+
+void GoldenRunner::finishCase(uint64_t frame, const CapturedImage* image) {
+    const GoldenCase& c = currentCase(frame);
+    CaseResult& r = results[caseIndex_(frame)];
+    std::string goldenPath = opts.dir + "/" + c.name + ".png";
+    if (!image) { r.status = Status::NoCapture; return; }
+    if (opts.update) {
+        r.status = GoldenImage::save(goldenPath, *image) ? Status::Updated : Status::Fail;
+        return;
+    }
+    CapturedImage reference;
+    if (!GoldenImage::load(goldenPath, reference)) { r.status = Status::Missing; return; }
+    CapturedImage diff;
+    r.image = GoldenImage::compare(reference, *image, opts.tolerance, &diff);
+    bool ok = r.image.sizeMatch && r.image.psnr >= opts.minPsnr && r.image.badFraction <= opts.maxBadFraction;
+    r.status = ok ? Status::Pass : Status::Fail;
+    if (ok) return;
+    GoldenImage::save(opts.outDir + "/" + c.name + ".actual.png", *image);
+    if (r.image.sizeMatch) GoldenImage::save(opts.outDir + "/" + c.name + ".diff.png", diff);
+}
+
+bool GoldenRunner::passed() const {
+    for (const CaseResult& r : results)
+        if (r.status != Status::Pass && r.status != Status::Updated) return false;
+    return !results.empty();
+}
+
+bool GoldenRunner::referencesMissing() const {
+    for (const CaseResult& r : results)
+        if (r.status != Status::Missing) return false;
+    return !results.empty();
+}
+
+static const char* statusName(int s) {
+    static const char* const names[] = {"pending", "pass", "FAIL", "updated", "missing golden", "no capture"};
+    return names[s];
+}
+
+void GoldenRunner::print(std::ostream& out) const {
+    out << "golden images (" << opts.dir << ", psnr >= " << opts.minPsnr << " dB, bad pixels <= " << opts.maxBadFraction * 100.0 << "%):\n";
+    out << std::fixed << std::setprecision(3);
+    for (size_t i = 0; i < cases.size(); ++i) {
+        const CaseResult& r = results[i];
+        out << "  " << std::left << std::setw(14) << cases[i].name << std::right << std::setw(15) << statusName((int)r.status);
+        if (r.status == Status::Pass || r.status == Status::Fail) {
+            if (!r.image.sizeMatch) out << "  size mismatch";
+            else out << "  psnr " << std::min(r.image.psnr, 99.0) << " bad " << r.image.badFraction * 100.0 << "% max " << r.image.maxDiff;
+        }
+        out << "  cpu " << (r.cpuFrames ? r.cpuMs / r.cpuFrames : 0.0) << " ms gpu " << (r.gpuFrames ? r.gpuMs / r.gpuFrames : 0.0) << " ms\n";
+    }
+    out << std::defaultfloat;
+    if (!passed()) out << "golden images: FAILED, see " << opts.outDir << "\n";
+}
+
+// PSNR ограничен 99 дБ: бесконечности в JSON нет
+bool GoldenRunner::writeReport(const std::string& path) const {
+    std::ofstream out(path, std::ios::trunc);
+    if (!out.is_open()) return false;
+    out << std::fixed << std::setprecision(4);
+    out << "{\n  \"passed\": " << (passed() ? "true" : "false") << ",\n  \"cases\": [";
+    for (size_t i = 0; i < cases.size(); ++i) {
+        const CaseResult& r = results[i];
+        out << (i ? ",\n" : "\n") << "    {\"name\": \"" << cases[i].name << "\", \"status\": \"" << statusName((int)r.status)
+            << "\", \"psnr\": " << std::min(r.image.psnr, 99.0) << ", \"bad_fraction\": " << r.image.badFraction
+            << ", \"max_diff\": " << r.image.maxDiff << ", \"cpu_ms\": " << (r.cpuFrames ? r.cpuMs / r.cpuFrames : 0.0)
+            << ", \"gpu_ms\": " << (r.gpuFrames ? r.gpuMs / r.gpuFrames : 0.0) << "}";
+    }
+    out << "\n  ]\n}\n";
+    return (bool)out;
+}
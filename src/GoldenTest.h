@@ -0,0 +1,85 @@
+#pragma once
+#include "Engine.h"
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Сравнение кадров с эталонными PNG
+namespace GoldenImage {
+    struct Result {
+        bool sizeMatch = true;
+        double psnr = 0.0;        // по RGB, дБ; бесконечность при полном совпадении
+        double badFraction = 0.0; // доля пикселей, у которых канал отличается больше допуска
+        int maxDiff = 0;
+    };
+
+    bool load(const std::string& path, CapturedImage& out);
+    bool save(const std::string& path, const CapturedImage& image);
+    // diff (если задан): эталон приглушённым серым, отличия выше допуска — красным
+    Result compare(const CapturedImage& reference, const CapturedImage& actual, int tolerance, CapturedImage* diff);
+}
+
+// Фиксированная сцена: камера, время анимации источников, ядро PCF и число
+// фонариков, разложенных по полу
+struct GoldenCase {
+    std::string name;
+    glm::vec3 position;
+    float yaw, pitch;
+    float time;
+    int pcfRadius;
+    uint32_t flashlights;
+};
+
+// Прогон случаев подряд, по framesPerCase кадров на случай: последний кадр
+// снимается и сравнивается с <dir>/<name>.png. При провале в outDir пишутся
+// снимок и картинка отличий. Заодно копятся времена кадров случая.
+class GoldenRunner {
+public:
+    struct Options {
+        std::string dir = "golden";
+        std::string outDir = "golden_out";
+        bool update = false;           // перезаписать эталоны вместо сравнения
+        double minPsnr = 40.0;
+        int tolerance = 8;             // допуск канала для badFraction, из 255
+        double maxBadFraction = 0.001;
+        uint32_t framesPerCase = 8;    // больше MAX_FRAMES: LOD и отсечение успевают устояться
+    };
+
+    static std::vector<GoldenCase> defaultCases();
+
+    void init(std::vector<GoldenCase> cases, const Options& options);
+    uint64_t totalFrames() const { return (uint64_t)cases.size() * opts.framesPerCase; }
+    bool caseStarts(uint64_t frame) const { return frame % opts.framesPerCase == 0; }
+    bool caseEnds(uint64_t frame) const { return frame % opts.framesPerCase == opts.framesPerCase - 1; }
+    const GoldenCase& currentCase(uint64_t frame) const { return cases[caseIndex_(frame)]; }
+
+    void addCpu(uint64_t frame, double ms);
+    void addGpu(uint64_t frame, double ms);
+    // image == nullptr — снимок не получен, случай проваливается
+    void finishCase(uint64_t frame, const CapturedImage* image);
+
+    bool passed() const;
+    // Ни одного эталона ещё нет: сравнивать не с чем, тест пропускается
+    bool referencesMissing() const;
+    void print(std::ostream& out) const;
+    bool writeReport(const std::string& path) const;
+
+private:
+    enum class Status { Pending, Pass, Fail, Updated, Missing, NoCapture };
+    struct CaseResult {
+        Status status = Status::Pending;
+        GoldenImage::Result image;
+        double cpuMs = 0.0, gpuMs = 0.0;
+        uint32_t cpuFrames = 0, gpuFrames = 0;
+    };
+
+    std::vector<GoldenCase> cases;
+    std::vector<CaseResult> results;
+    Options opts;
+
+    size_t caseIndex_(uint64_t frame) const { return std::min<size_t>((size_t)(frame / opts.framesPerCase), cases.size() - 1); }
+    // Первые MAX_FRAMES кадров случая ещё несут состояние предыдущего
+    bool measured_(uint64_t frame) const { return frame / opts.framesPerCase < cases.size() && frame % opts.framesPerCase >= (uint64_t)Engine::MAX_FRAMES; }
+};
@@ -0,0 +1,148 @@
+#include "GpuProfiler.h"
+#include <algorithm>
+#include <iomanip>
+
+static constexpr VkQueryPipelineStatisticFlags STATS_FLAGS =
+    VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+static constexpr uint32_t STATS_COUNT = 3;
+
+void GpuProfiler::init(VkPhysicalDevice phys, VkDevice dev, uint32_t queueFamily, float period, int framesInFlight, bool pipelineStats) {
+    device = dev;
+    uint32_t qfCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(phys, &qfCount, nullptr);
+    std::vector<VkQueueFamilyProperties> qf(qfCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(phys, &qfCount, qf.data());
+    uint32_t validBits = queueFamily < qfCount ? qf[queueFamily].timestampValidBits : 0;
+    if (validBits == 0) return;
+    timestampPeriod = period;
+    timestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+
+    uint32_t slotCount = (uint32_t)framesInFlight;
+    VkQueryPoolCreateInfo qci{VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO};
+    qci.queryType = VK_QUERY_TYPE_TIMESTAMP; qci.queryCount = slotCount * MAX_ZONES * 2;
+    vkCreateQueryPool(device, &qci, nullptr, &timestampPool);
+    if (pipelineStats) {
+        qci.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS; qci.queryCount = slotCount * MAX_ZONES;
+        qci.pipelineStatistics = STATS_FLAGS;
+        vkCreateQueryPool(device, &qci, nullptr, &statsPool);
+    }
+    slots.resize(slotCount);
+    for (auto& s : slots) s.zones.reserve(MAX_ZONES);
+    scratch.resize(MAX_ZONES * std::max<uint32_t>(2, STATS_COUNT));
+}
+
+void GpuProfiler::cleanup(VkDevice dev) {
+    if (timestampPool) vkDestroyQueryPool(dev, timestampPool, nullptr);
+    if (statsPool) vkDestroyQueryPool(dev, statsPool, nullptr);
+    timestampPool = statsPool = VK_NULL_HANDLE;
+    slots.clear();
+    if (csv.is_open()) csv.close();
+}
+
+bool GpuProfiler::openCsv(const std::string& path) {
+    csv.open(path, std::ios::trunc);
+    if (!csv.is_open()) return false;
+    csv << "frame,zone,gpu_ms,primitives,clip_primitives,fragments\n";
+    return true;
+}
+
+uint32_t GpuProfiler::zone(const std::string& name) {
+    for (uint32_t i = 0; i < zones.size(); ++i)
+        if (zones[i].stats.name == name) return i;
+    zones.emplace_back();
+    zones.back().stats.name = name;
+    return (uint32_t)zones.size() - 1;
+}
+
+void GpuProfiler::beginFrame(VkCommandBuffer cmd, int frameIndex) {
+    if (!enabled()) return;
+    currentSlot = frameIndex;
+    openZone = UINT32_MAX;
+    Slot& s = slots[frameIndex];
+    if (!s.zones.empty()) collect_(frameIndex);
+    s.zones.clear();
+    s.frame = frameCounter++;
+    vkCmdResetQueryPool(cmd, timestampPool, frameIndex * MAX_ZONES * 2, MAX_ZONES * 2);
+    if (statsPool) vkCmdResetQueryPool(cmd, statsPool, frameIndex * MAX_ZONES, MAX_ZONES);
+}
+
+// Начало зоны — TOP_OF_PIPE, конец — BOTTOM_OF_PIPE: зона накрывает всю
+// работу своих команд, перекрытие с хвостом предыдущего прохода входит в неё
+bool GpuProfiler::begin(VkCommandBuffer cmd, uint32_t zone) {
+    if (!enabled() || currentSlot < 0 || openZone != UINT32_MAX) return false;
+    Slot& s = slots[currentSlot];
+    if (s.zones.size() >= MAX_ZONES) return false;
+    uint32_t q = (uint32_t)(currentSlot * MAX_ZONES + s.zones.size());
+    vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestampPool, q * 2);
+    if (statsPool) vkCmdBeginQuery(cmd, statsPool, q, 0);
+    s.zones.push_back(zone);
+    openZone = zone;
+    return true;
+}
+
+void GpuProfiler::end(VkCommandBuffer cmd) {
+    if (openZone == UINT32_MAX) return;
+    Slot& s = slots[currentSlot];
+    uint32_t q = (uint32_t)(currentSlot * MAX_ZONES + s.zones.size() - 1);
+    if (statsPool) vkCmdEndQuery(cmd, statsPool, q);
+    vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestampPool, q * 2 + 1);
+    openZone = UINT32_MAX;
+}
+
+// Без VK_QUERY_RESULT_WAIT_BIT: если данных нет (кадр не был отправлен),
+// замер просто пропускается
+void GpuProfiler::collect_(int slot) {
+    Slot& s = slots[slot];
+    uint32_t n = (uint32_t)s.zones.size();
+    uint32_t first = slot * MAX_ZONES;
+    if (vkGetQueryPoolResults(device, timestampPool, first * 2, n * 2, n * 2 * sizeof(uint64_t), scratch.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) return;
+    std::array<float, MAX_ZONES> ms{};
+    for (uint32_t i = 0; i < n; ++i)
+        ms[i] = (float)((double)((scratch[i * 2 + 1] - scratch[i * 2]) & timestampMask) * timestampPeriod * 1e-6);
+    // Зоны пишутся по порядку, поэтому кадр — от первой метки до последней
+    lastFrameGpuMs = (float)((double)((scratch[n * 2 - 1] - scratch[0]) & timestampMask) * timestampPeriod * 1e-6);
+    ++framesCollected;
+    bool haveStats = statsPool && vkGetQueryPoolResults(device, statsPool, first, n, n * STATS_COUNT * sizeof(uint64_t), scratch.data(), STATS_COUNT * sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) == VK_SUCCESS;
+    for (uint32_t i = 0; i < n; ++i) {
+        Zone& z = zones[s.zones[i]];
+        addSample_(z, ms[i]);
+        // Порядок счётчиков — порядок битов в STATS_FLAGS
+        if (haveStats) {
+            z.stats.primitives = scratch[i * STATS_COUNT];
+            z.stats.clipPrimitives = scratch[i * STATS_COUNT + 1];
+            z.stats.fragments = scratch[i * STATS_COUNT + 2];
+        }
+        if (csv.is_open())
+            csv << s.frame << ',' << z.stats.name << ',' << ms[i] << ',' << z.stats.primitives << ',' << z.stats.clipPrimitives << ',' << z.stats.fragments << '\n';
+    }
+}
+
+void GpuProfiler::addSample_(Zone& z, float ms) {
+    z.history[z.head] = ms;
+    z.head = (z.head + 1) % WINDOW;
+    z.count = std::min(z.count + 1, WINDOW);
+    float lo = z.history[0], hi = z.history[0], sum = 0.0f;
+    for (uint32_t i = 0; i < z.count; ++i) {
+        lo = std::min(lo, z.history[i]); hi = std::max(hi, z.history[i]);
+        sum += z.history[i];
+    }
+    z.stats.minMs = lo; z.stats.maxMs = hi; z.stats.avgMs = sum / (float)z.count;
+    ++z.stats.samples;
+    z.stats.totalMs += ms;
+}
+
+void GpuProfiler::report(std::ostream& out) const {
+    if (!enabled()) { out << "gpu profiler: timestamps not supported\n"; return; }
+    out << "gpu zones (ms over last " << WINDOW << " frames: min/avg/max, lifetime avg):\n";
+    for (const Zone& z : zones) {
+        const ZoneStats& st = z.stats;
+        if (st.samples == 0) continue;
+        out << "  " << std::left << std::setw(20) << st.name << std::right << std::fixed << std::setprecision(3)
+            << st.minMs << " / " << st.avgMs << " / " << st.maxMs << "  (" << st.totalMs / (double)st.samples << " x " << st.samples << ")";
+        if (statsPool) out << "  prims " << st.primitives << " clipped " << st.clipPrimitives << " frags " << st.fragments;
+        out << '\n';
+    }
+    out << std::defaultfloat;
+}
@@ -0,0 +1,96 @@
+#pragma once
+#define GLFW_INCLUDE_VULKAN
+#include <GLFW/glfw3.h>
+#include <array>
+#include <fstream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// GPU-замеры проходов кадра: пара timestamp на зону плюс (если устройство
+// умеет) pipeline statistics. У каждого кадра в полёте свой диапазон
+// запросов; результаты кадра читаются, когда его слот используется снова —
+// fence к этому моменту уже пройден, поэтому чтение не ждёт GPU.
+// Зоны не вкладываются друг в друга: начало новой при открытой игнорируется.
+class GpuProfiler {
+public:
+    static constexpr uint32_t MAX_ZONES = 32;   // замеров за кадр
+    static constexpr uint32_t WINDOW = 120;     // кадров в скользящем окне
+
+    struct ZoneStats {
+        std::string name;
+        float minMs = 0.0f, avgMs = 0.0f, maxMs = 0.0f; // по последним WINDOW кадрам
+        uint64_t samples = 0;                           // за всё время
+        double totalMs = 0.0;
+        // Pipeline statistics последнего прочитанного кадра
+        uint64_t primitives = 0;     // собранные примитивы (input assembly)
+        uint64_t clipPrimitives = 0; // примитивы после отсечения
+        uint64_t fragments = 0;      // вызовы фрагментного шейдера
+    };
+
+    void init(VkPhysicalDevice phys, VkDevice device, uint32_t queueFamily, float timestampPeriod, int framesInFlight, bool pipelineStats);
+    void cleanup(VkDevice device);
+    bool enabled() const { return timestampPool != VK_NULL_HANDLE; }
+    bool hasPipelineStats() const { return statsPool != VK_NULL_HANDLE; }
+
+    // Построчный лог: frame,zone,gpu_ms,primitives,clip_primitives,fragments
+    bool openCsv(const std::string& path);
+
+    // Регистрирует зону по имени (повторный вызов вернёт тот же id). Лучше
+    // регистрировать заранее: первый вызов аллоцирует.
+    uint32_t zone(const std::string& name);
+    const ZoneStats& stats(uint32_t zone) const { return zones[zone].stats; }
+    size_t zoneCount() const { return zones.size(); }
+    void report(std::ostream& out) const;
+    // GPU-время последнего прочитанного кадра: от начала первой зоны до конца
+    // последней. completedFrames растёт на 1 с каждым прочитанным кадром.
+    uint64_t completedFrames() const { return framesCollected; }
+    float lastFrameMs() const { return lastFrameGpuMs; }
+
+    // Вызывается Engine::beginFrame после ожидания fence кадра
+    void beginFrame(VkCommandBuffer cmd, int frameIndex);
+    // false — зона не открыта (профайлер выключен, переполнение или вложенность)
+    bool begin(VkCommandBuffer cmd, uint32_t zone);
+    void end(VkCommandBuffer cmd);
+
+    class Scope {
+    public:
+        Scope(GpuProfiler& p, VkCommandBuffer cmd, uint32_t zone) : profiler(p), cmd(cmd), active(p.begin(cmd, zone)) {}
+        ~Scope() { if (active) profiler.end(cmd); }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+    private:
+        GpuProfiler& profiler;
+        VkCommandBuffer cmd;
+        bool active;
+    };
+
+private:
+    struct Zone {
+        ZoneStats stats;
+        std::array<float, WINDOW> history{};
+        uint32_t head = 0, count = 0;
+    };
+    struct Slot {
+        std::vector<uint32_t> zones; // порядок записи зон в кадре
+        uint64_t frame = 0;
+    };
+
+    VkDevice device = VK_NULL_HANDLE;
+    VkQueryPool timestampPool = VK_NULL_HANDLE;
+    VkQueryPool statsPool = VK_NULL_HANDLE;
+    float timestampPeriod = 0.0f;
+    uint64_t timestampMask = ~0ull;
+    std::vector<Zone> zones;
+    std::vector<Slot> slots;
+    std::vector<uint64_t> scratch;
+    int currentSlot = -1;
+    uint32_t openZone = UINT32_MAX;
+    uint64_t frameCounter = 0;
+    uint64_t framesCollected = 0;
+    float lastFrameGpuMs = 0.0f;
+    std::ofstream csv;
+
+    void collect_(int slot);
+    void addSample_(Zone& z, float ms);
+};
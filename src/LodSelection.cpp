@@ -0,0 +1,19 @@
+#include "LodSelection.h"
+
+namespace LodSelection {
+
+uint8_t select(const MeshLod* lods, uint32_t count, float pixelsPerUnit, uint8_t prev) {
+    if (count <= 1) return 0;
+    uint8_t ideal = 0, coarse = 0;
+    for (uint32_t i = 1; i < count; ++i) {
+        float px = lods[i].error * pixelsPerUnit;
+        if (px <= ERROR_PIXELS) ideal = (uint8_t)i;
+        if (px <= ERROR_PIXELS * COARSEN_FACTOR) coarse = (uint8_t)i;
+    }
+    if (prev >= count) return ideal;
+    if (coarse > prev) return coarse;
+    if (lods[prev].error * pixelsPerUnit > ERROR_PIXELS * REFINE_FACTOR) return ideal;
+    return prev;
+}
+
+} // namespace LodSelection
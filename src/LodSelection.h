@@ -0,0 +1,25 @@
+#pragma once
+
+#include "Engine.h"
+#include <glm/glm.hpp>
+#include <cmath>
+#include <cstdint>
+
+// Выбор LOD по экранной ошибке. Без Vulkan, чтобы проверяться CPU-тестом.
+namespace LodSelection {
+
+// Допустимая ошибка LOD на экране и полоса гистерезиса вокруг неё
+constexpr float ERROR_PIXELS = 1.0f;
+constexpr float COARSEN_FACTOR = 0.8f;
+constexpr float REFINE_FACTOR = 1.25f;
+
+// Пикселей на единицу длины на расстоянии 1. У Camera::projection
+// proj[1][1] отрицателен из-за флипа Y, поэтому берётся модуль.
+inline float pixelScale(const glm::mat4& proj, uint32_t viewportHeight) { return std::abs(proj[1][1]) * 0.5f * (float)viewportHeight; }
+
+// Грубее переходим, только когда ошибка заметно ниже порога, точнее — когда
+// текущий LOD заметно его превысил. Функция идемпотентна, поэтому теневой
+// проход, вызванный после основного, получит тот же LOD.
+uint8_t select(const MeshLod* lods, uint32_t count, float pixelsPerUnit, uint8_t prev);
+
+} // namespace LodSelection
@@ -0,0 +1,476 @@
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+namespace MeshOptimizer {
+
+VertexCacheStats analyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize) {
+    VertexCacheStats st;
+    if (indices.empty()) return st;
+    // Вершина в кэше, если её вставили не раньше cacheSize вставок назад
+    std::vector<uint32_t> stamp(vertexCount, 0);
+    std::vector<uint8_t> used(vertexCount, 0);
+    uint32_t time = cacheSize + 1;
+    size_t misses = 0, unique = 0;
+    for (uint32_t i : indices) {
+        if (time - stamp[i] > cacheSize) { stamp[i] = time++; ++misses; }
+        if (!used[i]) { used[i] = 1; ++unique; }
+    }
+    st.acmr = (float)misses / (float)(indices.size() / 3);
+    st.atvr = (float)misses / (float)unique;
+    return st;
+}
+
+namespace {
+
+constexpr int kCacheSize = 32;
+constexpr float kCacheDecayPower = 1.5f;
+constexpr float kLastTriScore = 0.75f;
+constexpr float kValenceBoostScale = 2.0f;
+constexpr float kValenceBoostPower = 0.5f;
+
+float vertexScore(int cachePos, uint32_t remaining) {
+    if (remaining == 0) return -1.0f;
+    float score = 0.0f;
+    if (cachePos >= 0) {
+        if (cachePos < 3) score = kLastTriScore;
+        else score = std::pow(1.0f - (float)(cachePos - 3) / (float)(kCacheSize - 3), kCacheDecayPower);
+    }
+    return score + kValenceBoostScale * std::pow((float)remaining, -kValenceBoostPower);
+}
+
+}
+
+void optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount) {
+    size_t triCount = indices.size() / 3;
+    if (triCount == 0) return;
+
+    // Списки смежных треугольников: первые remaining[v] элементов — ещё не выданные
+    std::vector<uint32_t> remaining(vertexCount, 0);
+    for (uint32_t i : indices) ++remaining[i];
+    std::vector<uint32_t> offsets(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; ++v) offsets[v + 1] = offsets[v] + remaining[v];
+    std::vector<uint32_t> adjacency(indices.size());
+    {
+        std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+        for (uint32_t t = 0; t < (uint32_t)triCount; ++t)
+            for (int k = 0; k < 3; ++k) adjacency[fill[indices[3 * t + k]]++] = t;
+    }
+
+    std::vector<int> cachePos(vertexCount, -1);
+    std::vector<float> vScore(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v) vScore[v] = vertexScore(-1, remaining[v]);
+    std::vector<float> tScore(triCount);
+    for (size_t t = 0; t < triCount; ++t)
+        tScore[t] = vScore[indices[3 * t]] + vScore[indices[3 * t + 1]] + vScore[indices[3 * t + 2]];
+    std::vector<uint8_t> emitted(triCount, 0);
+
+    std::vector<uint32_t> out;
+    out.reserve(indices.size());
+    uint32_t cache[kCacheSize + 3];
+    uint32_t newCache[kCacheSize + 3];
+    int cacheCount = 0;
+    size_t scan = 0;
+    uint32_t best = (uint32_t)(std::max_element(tScore.begin(), tScore.end()) - tScore.begin());
+
+    while (out.size() < triCount * 3) {
+        if (best == UINT32_MAX) {
+            // В кэше нет кандидатов — берём первый невыданный треугольник
+            while (emitted[scan]) ++scan;
+            best = (uint32_t)scan;
+        }
+        emitted[best] = 1;
+        int newCount = 0;
+        for (int k = 0; k < 3; ++k) {
+            uint32_t v = indices[3 * best + k];
+            out.push_back(v);
+            uint32_t* first = &adjacency[offsets[v]];
+            uint32_t* last = first + remaining[v] - 1;
+            std::iter_swap(std::find(first, last + 1, best), last);
+            --remaining[v];
+            if (std::find(newCache, newCache + newCount, v) == newCache + newCount) newCache[newCount++] = v;
+        }
+        int triVerts = newCount;
+        for (int i = 0; i < cacheCount; ++i) {
+            uint32_t v = cache[i];
+            if (std::find(newCache, newCache + triVerts, v) == newCache + triVerts) newCache[newCount++] = v;
+        }
+
+        // Пересчёт очков вершин (включая вытесненные) и их треугольников
+        for (int i = 0; i < newCount; ++i) {
+            uint32_t v = newCache[i];
+            cachePos[v] = i < kCacheSize ? i : -1;
+            float s = vertexScore(cachePos[v], remaining[v]);
+            float delta = s - vScore[v];
+            vScore[v] = s;
+            for (uint32_t a = 0; a < remaining[v]; ++a) tScore[adjacency[offsets[v] + a]] += delta;
+        }
+        cacheCount = std::min(newCount, kCacheSize);
+        for (int i = 0; i < cacheCount; ++i) cache[i] = newCache[i];
+
+        best = UINT32_MAX;
+        float bestScore = -1.0f;
+        for (int i = 0; i < cacheCount; ++i) {
+            uint32_t v = cache[i];
+            for (uint32_t a = 0; a < remaining[v]; ++a) {
+                uint32_t t = adjacency[offsets[v] + a];
+                if (tScore[t] > bestScore) { bestScore = tScore[t]; best = t; }
+            }
+        }
+    }
+    indices.swap(out);
+}
+
+void optimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<Vertex>& verts, float threshold) {
+    constexpr uint32_t kCache = 16;
+    constexpr size_t kMinCluster = 32;
+    size_t triCount = indices.size() / 3;
+    if (triCount <= kMinCluster) return;
+    float acmr = analyzeVertexCache(indices, verts.size(), kCache).acmr;
+
+    // Границы кластеров: треугольник с тремя промахами (кэш «перезапустился»)
+    // либо с двумя, если кластер уже не хуже среднего ACMR с запасом threshold.
+    // Резать посреди полосы нельзя — каждый разрыв стоит лишних промахов.
+    std::vector<size_t> clusterStart{0};
+    std::vector<uint32_t> stamp(verts.size(), 0);
+    uint32_t time = kCache + 1;
+    size_t clusterMisses = 0;
+    for (size_t t = 0; t < triCount; ++t) {
+        int misses = 0;
+        for (int k = 0; k < 3; ++k) {
+            uint32_t v = indices[3 * t + k];
+            if (time - stamp[v] > kCache) { stamp[v] = time++; ++misses; }
+        }
+        size_t len = t - clusterStart.back();
+        if (len >= kMinCluster && (misses == 3 || (misses >= 2 && (float)clusterMisses / (float)len <= acmr * threshold))) {
+            clusterStart.push_back(t);
+            clusterMisses = 0;
+        }
+        clusterMisses += misses;
+    }
+    clusterStart.push_back(triCount);
+    size_t clusterCount = clusterStart.size() - 1;
+    if (clusterCount < 2) return;
+
+    glm::vec3 meshCenter(0.0f);
+    float meshArea = 0.0f;
+    std::vector<glm::vec3> centers(clusterCount), normals(clusterCount);
+    for (size_t c = 0; c < clusterCount; ++c) {
+        glm::vec3 center(0.0f), normal(0.0f);
+        float area = 0.0f;
+        for (size_t t = clusterStart[c]; t < clusterStart[c + 1]; ++t) {
+            const glm::vec3& a = verts[indices[3 * t]].pos;
+            const glm::vec3& b = verts[indices[3 * t + 1]].pos;
+            const glm::vec3& d = verts[indices[3 * t + 2]].pos;
+            glm::vec3 n = glm::cross(b - a, d - a);
+            float ta = glm::length(n);
+            center += (a + b + d) * (ta / 3.0f);
+            normal += n;
+            area += ta;
+        }
+        meshCenter += center;
+        meshArea += area;
+        centers[c] = area > 0.0f ? center / area : verts[indices[3 * clusterStart[c]]].pos;
+        normals[c] = normal;
+    }
+    if (meshArea > 0.0f) meshCenter /= meshArea;
+
+    std::vector<float> keys(clusterCount);
+    for (size_t c = 0; c < clusterCount; ++c) {
+        float nl = glm::length(normals[c]);
+        keys[c] = nl > 0.0f ? glm::dot(centers[c] - meshCenter, normals[c] / nl) : 0.0f;
+    }
+    std::vector<size_t> order(clusterCount);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return keys[a] > keys[b]; });
+
+    std::vector<uint32_t> out;
+    out.reserve(indices.size());
+    for (size_t c : order)
+        out.insert(out.end(), indices.begin() + 3 * clusterStart[c], indices.begin() + 3 * clusterStart[c + 1]);
+    indices.swap(out);
+}
+
+void optimizeVertexFetch(std::vector<Vertex>& verts, std::vector<uint32_t>& indices) {
+    std::vector<uint32_t> remap(verts.size(), UINT32_MAX);
+    std::vector<Vertex> out;
+    out.reserve(verts.size());
+    for (auto& i : indices) {
+        if (remap[i] == UINT32_MAX) {
+            remap[i] = (uint32_t)out.size();
+            out.push_back(verts[i]);
+        }
+        i = remap[i];
+    }
+    verts.swap(out);
+}
+
+namespace {
+
+// Симметричная 4x4 квадрика (10 коэффициентов) и суммарный вес плоскостей
+struct Quadric {
+    double a[10] = {};
+    double w = 0.0;
+
+    void addPlane(const glm::vec3& n, float d, double weight) {
+        double p[4] = {n.x, n.y, n.z, d};
+        int k = 0;
+        for (int i = 0; i < 4; ++i)
+            for (int j = i; j < 4; ++j) a[k++] += weight * p[i] * p[j];
+        w += weight;
+    }
+    Quadric& operator+=(const Quadric& o) {
+        for (int i = 0; i < 10; ++i) a[i] += o.a[i];
+        w += o.w;
+        return *this;
+    }
+    // Средний квадрат расстояния от точки до плоскостей
+    double eval(const glm::vec3& v) const {
+        double x = v.x, y = v.y, z = v.z;
+        double e = a[0]*x*x + 2*a[1]*x*y + 2*a[2]*x*z + 2*a[3]*x
+                 + a[4]*y*y + 2*a[5]*y*z + 2*a[6]*y
+                 + a[7]*z*z + 2*a[8]*z
+                 + a[9];
+        return w > 0.0 ? std::max(e, 0.0) / w : 0.0;
+    }
+};
+
+struct Collapse {
+    uint32_t from, to;
+    double cost;
+};
+
+struct PosHash {
+    size_t operator()(const glm::vec3& p) const {
+        uint32_t b[3];
+        std::memcpy(b, &p, sizeof(b));
+        return (size_t)b[0] * 73856093u ^ (size_t)b[1] * 19349663u ^ (size_t)b[2] * 83492791u;
+    }
+};
+
+uint64_t edgeKey(uint32_t a, uint32_t b) {
+    if (a > b) std::swap(a, b);
+    return ((uint64_t)a << 32) | b;
+}
+
+}
+
+float simplify(const std::vector<uint32_t>& indices, const std::vector<Vertex>& verts, size_t targetIndexCount, std::vector<uint32_t>& out) {
+    out = indices;
+    size_t n = verts.size();
+    if (out.size() <= targetIndexCount || n == 0) return 0.0f;
+
+    // Вершины с одинаковой позицией, но разными нормалями/UV — шов, их не трогаем
+    std::unordered_map<glm::vec3, uint32_t, PosHash> posIds;
+    std::vector<uint32_t> posId(n);
+    std::vector<uint32_t> posUsers;
+    for (size_t v = 0; v < n; ++v) {
+        auto [it, inserted] = posIds.try_emplace(verts[v].pos, (uint32_t)posUsers.size());
+        if (inserted) posUsers.push_back(0);
+        posId[v] = it->second;
+        ++posUsers[it->second];
+    }
+    std::vector<uint8_t> lockedPos(posUsers.size(), 0);
+    for (size_t p = 0; p < posUsers.size(); ++p) lockedPos[p] = posUsers[p] > 1;
+
+    // Рёбра, у которых не ровно два треугольника — граница или неманифолд
+    std::unordered_map<uint64_t, uint32_t> edgeUse;
+    edgeUse.reserve(out.size());
+    for (size_t t = 0; t < out.size(); t += 3)
+        for (int k = 0; k < 3; ++k) ++edgeUse[edgeKey(posId[out[t + k]], posId[out[t + (k + 1) % 3]])];
+    for (const auto& [key, count] : edgeUse) {
+        if (count == 2) continue;
+        lockedPos[key >> 32] = 1;
+        lockedPos[key & 0xffffffffu] = 1;
+    }
+
+    std::vector<Quadric> quadrics(n);
+    for (size_t t = 0; t < out.size(); t += 3) {
+        const glm::vec3& a = verts[out[t]].pos;
+        const glm::vec3& b = verts[out[t + 1]].pos;
+        const glm::vec3& c = verts[out[t + 2]].pos;
+        glm::vec3 nrm = glm::cross(b - a, c - a);
+        float len = glm::length(nrm);
+        if (len <= 0.0f) continue;
+        nrm /= len;
+        for (int k = 0; k < 3; ++k) quadrics[out[t + k]].addPlane(nrm, -glm::dot(nrm, a), 0.5 * len);
+    }
+
+    std::vector<uint32_t> remap(n);
+    std::vector<uint8_t> touched(n);
+    std::vector<Collapse> candidates;
+    std::vector<uint32_t> adjOffsets(n + 1), adjacency;
+    double maxCost = 0.0;
+
+    while (out.size() > targetIndexCount) {
+        size_t triCount = out.size() / 3;
+
+        // Треугольники вокруг каждой вершины — для проверки переворота
+        std::fill(adjOffsets.begin(), adjOffsets.end(), 0);
+        for (uint32_t i : out) ++adjOffsets[i + 1];
+        for (size_t v = 0; v < n; ++v) adjOffsets[v + 1] += adjOffsets[v];
+        adjacency.resize(out.size());
+        {
+            std::vector<uint32_t> fill(adjOffsets.begin(), adjOffsets.end() - 1);
+            for (size_t i = 0; i < out.size(); ++i) adjacency[fill[out[i]]++] = (uint32_t)(i / 3);
+        }
+
+        candidates.clear();
+        for (size_t t = 0; t < out.size(); t += 3) {
+            for (int k = 0; k < 3; ++k) {
+                uint32_t a = out[t + k], b = out[t + (k + 1) % 3];
+                if (a == b) continue;
+                Quadric q = quadrics[a];
+                q += quadrics[b];
+                if (!lockedPos[posId[a]]) candidates.push_back({a, b, q.eval(verts[b].pos)});
+                if (!lockedPos[posId[b]]) candidates.push_back({b, a, q.eval(verts[a].pos)});
+            }
+        }
+        if (candidates.empty()) break;
+        std::sort(candidates.begin(), candidates.end(), [](const Collapse& x, const Collapse& y) { return x.cost < y.cost; });
+
+        for (size_t v = 0; v < n; ++v) remap[v] = (uint32_t)v;
+        std::fill(touched.begin(), touched.end(), 0);
+        size_t removed = 0, needed = triCount - targetIndexCount / 3;
+        for (const Collapse& c : candidates) {
+            if (removed >= needed) break;
+            if (touched[c.from] || touched[c.to]) continue;
+
+            // Отказ, если какой-то из оставшихся треугольников перевернётся
+            bool flips = false;
+            size_t dying = 0;
+            for (uint32_t a = adjOffsets[c.from]; a < adjOffsets[c.from + 1] && !flips; ++a) {
+                const uint32_t* tri = &out[3 * adjacency[a]];
+                if (tri[0] == c.to || tri[1] == c.to || tri[2] == c.to) { ++dying; continue; }
+                glm::vec3 p[3], q[3];
+                for (int k = 0; k < 3; ++k) {
+                    p[k] = verts[tri[k]].pos;
+                    q[k] = tri[k] == c.from ? verts[c.to].pos : p[k];
+                }
+                glm::vec3 n0 = glm::cross(p[1] - p[0], p[2] - p[0]);
+                glm::vec3 n1 = glm::cross(q[1] - q[0], q[2] - q[0]);
+                flips = glm::dot(n0, n1) <= 0.0f;
+            }
+            if (flips || dying == 0) continue;
+
+            remap[c.from] = c.to;
+            quadrics[c.to] += quadrics[c.from];
+            for (uint32_t a = adjOffsets[c.from]; a < adjOffsets[c.from + 1]; ++a)
+                for (int k = 0; k < 3; ++k) touched[out[3 * adjacency[a] + k]] = 1;
+            removed += dying;
+            maxCost = std::max(maxCost, c.cost);
+        }
+        if (removed == 0) break;
+
+        size_t w = 0;
+        for (size_t t = 0; t < out.size(); t += 3) {
+            uint32_t a = remap[out[t]], b = remap[out[t + 1]], c = remap[out[t + 2]];
+            if (a == b || b == c || a == c) continue;
+            out[w++] = a; out[w++] = b; out[w++] = c;
+        }
+        out.resize(w);
+    }
+    return (float)std::sqrt(maxCost);
+}
+
+void generateLods(const std::vector<Vertex>& verts, std::vector<uint32_t>& indices, std::vector<MeshLod>& lods, int maxLods) {
+    constexpr size_t kMinLodIndices = 3 * 64;
+    lods.assign(1, MeshLod{0, (uint32_t)indices.size(), 0.0f});
+    size_t baseCount = indices.size();
+    // Каждый уровень строится из LOD0, чтобы ошибка не накапливалась
+    std::vector<uint32_t> base(indices.begin(), indices.end());
+    std::vector<uint32_t> lod;
+    size_t prevCount = baseCount;
+    for (int l = 1; l < maxLods; ++l) {
+        size_t target = (prevCount / 2) / 3 * 3;
+        if (target < kMinLodIndices) break;
+        float error = simplify(base, verts, target, lod);
+        // Упрощение упёрлось в закреплённые вершины — дальше смысла нет
+        if (lod.size() > prevCount * 85 / 100) break;
+        optimizeVertexCache(lod, verts.size());
+        lods.push_back({(uint32_t)indices.size(), (uint32_t)lod.size(), std::max(error, lods.back().error)});
+        indices.insert(indices.end(), lod.begin(), lod.end());
+        prevCount = lod.size();
+    }
+}
+
+void buildMeshlets(const std::vector<Vertex>& verts, const std::vector<uint32_t>& indices, size_t indexCount, std::vector<Meshlet>& out) {
+    out.clear();
+    if (indexCount == 0) return;
+
+    // Замкнутость проверяем по рёбрам между позициями, а не индексами: швы UV
+    // разрезают сетку по индексам, но не по геометрии
+    std::unordered_map<glm::vec3, uint32_t, PosHash> posIds;
+    std::vector<uint32_t> posId(verts.size());
+    for (size_t v = 0; v < verts.size(); ++v)
+        posId[v] = posIds.try_emplace(verts[v].pos, (uint32_t)posIds.size()).first->second;
+    std::unordered_map<uint64_t, uint32_t> edgeUse;
+    edgeUse.reserve(indexCount);
+    for (size_t t = 0; t < indexCount; t += 3)
+        for (int k = 0; k < 3; ++k) ++edgeUse[edgeKey(posId[indices[t + k]], posId[indices[t + (k + 1) % 3]])];
+    bool closed = std::all_of(edgeUse.begin(), edgeUse.end(), [](const auto& e) { return e.second == 2; });
+
+    std::vector<uint32_t> local;
+    local.reserve(MESHLET_MAX_VERTICES);
+    auto finish = [&](uint32_t first, uint32_t end) {
+        Meshlet m;
+        m.firstIndex = first;
+        m.indexCount = end - first;
+        glm::vec3 lo = verts[indices[first]].pos, hi = lo;
+        glm::vec3 axis(0.0f);
+        for (uint32_t i = first; i < end; ++i) {
+            lo = glm::min(lo, verts[indices[i]].pos);
+            hi = glm::max(hi, verts[indices[i]].pos);
+        }
+        glm::vec3 center = (lo + hi) * 0.5f;
+        float r2 = 0.0f;
+        for (uint32_t i = first; i < end; ++i) {
+            glm::vec3 d = verts[indices[i]].pos - center;
+            r2 = std::max(r2, glm::dot(d, d));
+        }
+        m.sphere = glm::vec4(center, std::sqrt(r2));
+
+        std::vector<glm::vec3> normals;
+        normals.reserve(m.indexCount / 3);
+        for (uint32_t i = first; i < end; i += 3) {
+            const glm::vec3& a = verts[indices[i]].pos;
+            glm::vec3 n = glm::cross(verts[indices[i + 1]].pos - a, verts[indices[i + 2]].pos - a);
+            float len = glm::length(n);
+            if (len <= 0.0f) continue;
+            normals.push_back(n / len);
+            axis += n / len;
+        }
+        float axisLen = glm::length(axis);
+        if (closed && axisLen > 0.0f) {
+            axis /= axisLen;
+            float minDot = 1.0f;
+            for (const auto& n : normals) minDot = std::min(minDot, glm::dot(n, axis));
+            // Разброс нормалей шире ~84° — конус ничего не отсечёт
+            if (minDot > 0.1f) m.cone = glm::vec4(axis, std::sqrt(1.0f - minDot * minDot));
+        }
+        out.push_back(m);
+    };
+
+    uint32_t first = 0;
+    for (uint32_t t = 0; t < (uint32_t)indexCount; t += 3) {
+        uint32_t extra = 0;
+        for (int k = 0; k < 3; ++k) {
+            uint32_t v = indices[t + k];
+            if (std::find(local.begin(), local.end(), v) == local.end() &&
+                std::find(indices.begin() + t, indices.begin() + t + k, v) == indices.begin() + t + k) ++extra;
+        }
+        if (local.size() + extra > MESHLET_MAX_VERTICES || (t - first) / 3 >= MESHLET_MAX_TRIANGLES) {
+            finish(first, t);
+            first = t;
+            local.clear();
+        }
+        for (int k = 0; k < 3; ++k)
+            if (std::find(local.begin(), local.end(), indices[t + k]) == local.end()) local.push_back(indices[t + k]);
+    }
+    finish(first, (uint32_t)indexCount);
+}
+
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "Engine.h"
+#include <vector>
+#include <cstdint>
+
+// Оптимизация индексированных мешей при загрузке.
+// Порядок применения: optimizeVertexCache -> optimizeOverdraw -> optimizeVertexFetch.
+namespace MeshOptimizer {
+
+struct VertexCacheStats {
+    float acmr = 0.0f; // промахи кэша на треугольник (идеал 0.5, худший случай 3)
+    float atvr = 0.0f; // промахи на уникальную вершину (идеал 1)
+};
+
+// Симуляция FIFO-кэша пост-трансформа
+VertexCacheStats analyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize = 16);
+
+// Переупорядочивает треугольники под кэш вершин (алгоритм Форсайта)
+void optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount);
+
+// Режет уже оптимизированный под кэш поток на кластеры и сортирует их так,
+// чтобы наружу смотрящие рисовались первыми. threshold — допустимое ухудшение ACMR.
+void optimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<Vertex>& verts, float threshold = 1.05f);
+
+// Переставляет вершины в порядке первого использования и выкидывает неиспользуемые
+void optimizeVertexFetch(std::vector<Vertex>& verts, std::vector<uint32_t>& indices);
+
+constexpr uint32_t MESHLET_MAX_VERTICES = 64;
+constexpr uint32_t MESHLET_MAX_TRIANGLES = 124;
+
+// Режет первые indexCount индексов на кластеры подряд идущих треугольников
+// (порядок уже оптимизирован под кэш, поэтому кластеры получаются компактными).
+// Конус нормалей считается только для замкнутых мешей: G-буфер рисует обе
+// стороны, и у открытой сетки изнанка видна. У остальных cutoff = 1.
+void buildMeshlets(const std::vector<Vertex>& verts, const std::vector<uint32_t>& indices, size_t indexCount, std::vector<Meshlet>& out);
+
+// Упрощение схлопыванием рёбер по квадрикам (QEM) до targetIndexCount индексов.
+// Вершины границ и швов атрибутов не двигаются. Вершинный буфер не меняется,
+// результат ссылается на те же вершины. Возвращает ошибку в единицах модели.
+float simplify(const std::vector<uint32_t>& indices, const std::vector<Vertex>& verts, size_t targetIndexCount, std::vector<uint32_t>& out);
+
+// Дописывает в indices цепочку LOD (каждый примерно вдвое проще предыдущего)
+// поверх общего вершинного буфера. lods[0] — исходная сетка.
+void generateLods(const std::vector<Vertex>& verts, std::vector<uint32_t>& indices, std::vector<MeshLod>& lods, int maxLods = Engine::MAX_LODS);
+
+}
@@ -0,0 +1,49 @@
+#include "RangeAllocator.h"
+#include <algorithm>
+
+uint32_t RangeAllocator::allocate(uint32_t count) {
+    for (size_t i = 0; i < freeRanges.size(); ++i) {
+        Range& r = freeRanges[i];
+        if (r.count < count) continue;
+        uint32_t offset = r.offset;
+        r.offset += count;
+        r.count -= count;
+        if (r.count == 0) freeRanges.erase(freeRanges.begin() + i);
+        return offset;
+    }
+    // Свободный хвост массива дополняется до нужного размера
+    if (!freeRanges.empty() && freeRanges.back().offset + freeRanges.back().count == end) {
+        uint32_t offset = freeRanges.back().offset;
+        end = offset + count;
+        freeRanges.pop_back();
+        return offset;
+    }
+    uint32_t offset = end;
+    end += count;
+    return offset;
+}
+
+void RangeAllocator::release(uint32_t offset, uint32_t count) {
+    if (count == 0) return;
+    auto next = std::lower_bound(freeRanges.begin(), freeRanges.end(), offset,
+                                 [](const Range& r, uint32_t o) { return r.offset < o; });
+    bool mergePrev = next != freeRanges.begin() && std::prev(next)->offset + std::prev(next)->count == offset;
+    bool mergeNext = next != freeRanges.end() && offset + count == next->offset;
+    if (mergePrev && mergeNext) {
+        std::prev(next)->count += count + next->count;
+        freeRanges.erase(next);
+    } else if (mergePrev) {
+        std::prev(next)->count += count;
+    } else if (mergeNext) {
+        next->offset = offset;
+        next->count += count;
+    } else {
+        freeRanges.insert(next, Range{offset, count});
+    }
+}
+
+uint32_t RangeAllocator::freeCount() const {
+    uint32_t total = 0;
+    for (const Range& r : freeRanges) total += r.count;
+    return total;
+}
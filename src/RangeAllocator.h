@@ -0,0 +1,22 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+// Раздаёт непрерывные диапазоны [offset, offset + count) в общем массиве.
+// Освобождённые диапазоны сливаются с соседями и отдаются заново (первый
+// подходящий); выданные диапазоны никогда не сдвигаются, массив только растёт.
+class RangeAllocator {
+public:
+    uint32_t allocate(uint32_t count);
+    void release(uint32_t offset, uint32_t count);
+    void clear() { freeRanges.clear(); end = 0; }
+
+    // Нужный размер массива: конец самого дальнего когда-либо выданного диапазона
+    uint32_t size() const { return end; }
+    uint32_t freeCount() const;
+
+private:
+    struct Range { uint32_t offset, count; };
+    std::vector<Range> freeRanges; // по возрастанию offset, соседние слиты
+    uint32_t end = 0;
+};
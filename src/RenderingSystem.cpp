@@ -1,20 +1,80 @@
 #include "RenderingSystem.h"
+#include "CpuProfiler.h"
+#include "LodSelection.h"
 #include <array>
 #include <cstring>
+#include <cmath>
+#include <cstddef>
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
 
+// Ровно 128 байт — минимальный гарантированный maxPushConstantsSize
 struct GeomPC {
     glm::mat4 model;
+    glm::vec4 normalMat[3]; // столбцы матрицы нормалей, normalMat[0].w — признак unlit, normalMat[1].w — индекс текстуры
     glm::vec4 color;
-    int isUnlit;
-    int pad[3];
 };
 
+static const char* const LIGHT_VARIANT_NAMES[] = {"no-shadows", "pcf1x1", "pcf3x3", "pcf5x5"};
+
 struct ShadowPC {
     glm::mat4 model;
     glm::mat4 lightSpace;
 };
 
+struct Frustum {
+    glm::vec4 planes[6];
+};
+
+// Плоскости отсечения из view-proj (глубина 0..1)
+static Frustum extractFrustum(const glm::mat4& m) {
+    glm::mat4 t = glm::transpose(m);
+    Frustum f;
+    f.planes[0] = t[3] + t[0]; f.planes[1] = t[3] - t[0];
+    f.planes[2] = t[3] + t[1]; f.planes[3] = t[3] - t[1];
+    f.planes[4] = t[2];        f.planes[5] = t[3] - t[2];
+    for (auto& p : f.planes) p /= glm::length(glm::vec3(p));
+    return f;
+}
+
+static bool sphereVisible(const Frustum& f, const glm::vec3& c, float r) {
+    for (const auto& p : f.planes)
+        if (glm::dot(glm::vec3(p), c) + p.w < -r) return false;
+    return true;
+}
+
+static float maxScale(const glm::mat4& m) {
+    float sx = glm::dot(glm::vec3(m[0]), glm::vec3(m[0]));
+    float sy = glm::dot(glm::vec3(m[1]), glm::vec3(m[1]));
+    float sz = glm::dot(glm::vec3(m[2]), glm::vec3(m[2]));
+    return std::sqrt(std::max(sx, std::max(sy, sz)));
+}
+
+// Sponza полна двусторонних листьев и тканей, поэтому G-буфер задние грани
+// не отбрасывает.
+static constexpr VkCullModeFlags GBUFFER_CULL_MODE = VK_CULL_MODE_NONE;
+
+// Рабочий конус есть только у кластеров замкнутых мешей (у открытых cutoff = 1).
+// Изнанка замкнутого меша закрыта его лицевыми гранями, пока камера снаружи,
+// поэтому отсечение по конусу безопасно и без отбрасывания задних граней.
+// Неравномерный масштаб искажает нормали, и конус перестаёт быть верным.
+static bool coneCullingSafe(const glm::mat4& world, const glm::vec4& bounds, uint32_t objectFlags, const glm::vec3& eye) {
+    if (!(objectFlags & SCENE_UNIFORM)) return false;
+    glm::vec3 c = glm::vec3(world * glm::vec4(glm::vec3(bounds), 1.0f));
+    float r = bounds.w * maxScale(world);
+    glm::vec3 d = eye - c;
+    return glm::dot(d, d) > r * r;
+}
+
+// Столько же, сколько нарисует bindAndDrawMesh_
+static uint64_t lodTriangles(const Engine& engine, MeshHandle mesh, uint32_t lod) {
+    uint32_t count = engine.getMeshLodCount(mesh);
+    return count ? engine.getMeshLod(mesh, std::min(lod, count - 1)).indexCount / 3 : 0;
+}
+
 void RenderingSystem::init(Engine& engine) {
+    auto start = std::chrono::steady_clock::now();
     auto ext = engine.getSwapExtent();
     gbuffer.init(engine, ext.width, ext.height);
     createShadowResources_(engine);
@@ -24,7 +84,11 @@ void RenderingSystem::init(Engine& engine) {
     createLightPipeline_(engine);
     createFramebuffers_(engine);
     createDescriptors_(engine);
-    updateLightDescSets_(engine);
+    for (int i = 0; i < Engine::MAX_FRAMES; ++i) updateLightDescSet_(engine, i);
+    clusterCuller.init(engine);
+    registerProfilerZones_(engine.getGpuProfiler());
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "rendering init: " << ms << " ms (" << (engine.isPipelineCacheWarm() ? "warm" : "cold") << " pipeline cache)\n";
 }
 
 void RenderingSystem::cleanup(Engine& engine) {
@@ -32,7 +96,7 @@ void RenderingSystem::cleanup(Engine& engine) {
     vkDeviceWaitIdle(dev);
     cleanupFramebuffers_(dev);
     vkDestroyRenderPass(dev, lightRenderPass, nullptr);
-    vkDestroyPipeline(dev, lightPipeline, nullptr);
+    for (auto p : lightPipelines) vkDestroyPipeline(dev, p, nullptr);
     vkDestroyPipelineLayout(dev, lightPipelineLayout, nullptr);
     vkDestroyDescriptorSetLayout(dev, lightDescLayout, nullptr);
     vkDestroyDescriptorPool(dev, lightDescPool, nullptr);
@@ -48,30 +112,42 @@ void RenderingSystem::cleanup(Engine& engine) {
     for(auto f : shadowFramebuffers) vkDestroyFramebuffer(dev, f, nullptr);
     vkDestroyImage(dev, shadowImage, nullptr);
     vkFreeMemory(dev, shadowMemory, nullptr);
-    vkDestroySampler(dev, shadowSampler, nullptr);
     for (int i = 0; i < Engine::MAX_FRAMES; ++i) {
         vkDestroyBuffer(dev, geomUBOBufs[i], nullptr); vkFreeMemory(dev, geomUBOMems[i], nullptr);
         vkDestroyBuffer(dev, lightUBOBufs[i], nullptr); vkFreeMemory(dev, lightUBOMems[i], nullptr);
     }
+    clusterCuller.cleanup(dev);
     gbuffer.cleanup(dev);
 }
 
+// Без ожидания устройства: старые framebuffer уходят в Engine::retire, а
+// наборы освещения со ссылками на вложения G-буфера могут быть заняты кадрами
+// в полёте, поэтому каждый переписывается в recordFrame своего слота
 void RenderingSystem::onResize(Engine& engine) {
-    VkDevice dev = engine.getDevice();
     auto ext = engine.getSwapExtent();
-    cleanupFramebuffers_(dev);
-    gbuffer.recreate(engine, ext.width, ext.height);
+    for (auto fb : lightFramebuffers) engine.retire(VK_OBJECT_TYPE_FRAMEBUFFER, fb);
+    lightFramebuffers.clear();
+    if (gbuffer.recreate(engine, ext.width, ext.height)) staleLightSets = (1u << Engine::MAX_FRAMES) - 1;
     createFramebuffers_(engine);
-    updateLightDescSets_(engine);
 }
 
-void RenderingSystem::recordFrame(VkCommandBuffer cmd, uint32_t imageIndex, int frameIndex, const Camera& camera, const std::vector<SceneObject>& objects, Engine& engine) {
+void RenderingSystem::recordFrame(VkCommandBuffer cmd, uint32_t imageIndex, int frameIndex, const Camera& camera, Scene& scene, Engine& engine) {
     auto ext = engine.getSwapExtent();
+    if (staleLightSets & (1u << frameIndex)) {
+        updateLightDescSet_(engine, frameIndex);
+        staleLightSets &= ~(1u << frameIndex);
+    }
+    const auto& transforms = scene.getTransforms();
+    const auto& normalMats = scene.getNormalMatrices();
+    const auto& flags = scene.getFlags();
+    const auto& subMeshes = scene.getSubMeshes();
 
     GeomUBO gubo{};
     gubo.view = camera.view();
     gubo.proj = camera.projection((float)ext.width / (float)ext.height);
     memcpy(geomUBOMapped[frameIndex], &gubo, sizeof(GeomUBO));
+    // LOD всегда выбирается от основной камеры, в том числе для теней
+    LodView lodView{camera.position, LodSelection::pixelScale(gubo.proj, ext.height)};
 
     LightsUBO lubo{};
     lubo.viewPos = glm::vec4(camera.position, 1.0f);
@@ -80,32 +156,60 @@ void RenderingSystem::recordFrame(VkCommandBuffer cmd, uint32_t imageIndex, int
     lubo.invViewProj = glm::inverse(gubo.proj * gubo.view);
 
     int cnt = std::min((int)pendingLights.size(), MAX_LIGHTS);
+    frameStats = {};
+    frameStats.lights = (uint32_t)cnt;
     lubo.countPad.x = cnt;
     for (int i = 0; i < cnt; ++i) lubo.lights[i] = pendingLights[i];
     memcpy(lightUBOMapped[frameIndex], &lubo, sizeof(LightsUBO));
 
+    // Отбор для камеры идёт первым: по нему собираются задания отсечения
+    // кластеров, а compute-проход должен закончиться до G-буфера
+    glm::mat4 viewProj = gubo.proj * gubo.view;
+    uint64_t cullStart = CpuProfiler::nowNs();
+    cullScene_(scene, viewProj, lodView, engine, false, drawList);
+    uint64_t cullNs = CpuProfiler::nowNs() - cullStart;
+    clusterCuller.clearJobs();
+    drawJobs.clear();
+    for (const DrawItem& d : drawList.draws()) {
+        const SceneSubMesh& sm = subMeshes[d.subMesh];
+        uint32_t job = UINT32_MAX;
+        // Кластеры есть только у LOD0; грубые LOD рисуются целиком
+        if (sm.lod == 0 && engine.getMeshletCount(sm.mesh) > 0)
+            job = clusterCuller.addJob(engine, sm.mesh, transforms[d.object], coneCullingSafe(transforms[d.object], sm.bounds, flags[d.object], camera.position));
+        drawJobs.push_back(job);
+    }
+    GpuProfiler& profiler = engine.getGpuProfiler();
+    {
+        GpuProfiler::Scope zone(profiler, cmd, cullZone);
+        clusterCuller.dispatch(cmd, engine, frameIndex, extractFrustum(viewProj).planes, camera.position);
+    }
+
     for (int i = 0; i < cnt; ++i) {
         if (pendingLights[i].params2.x > 0.5f) {
             int layer = (int)pendingLights[i].params2.y;
+            GpuProfiler::Scope zone(profiler, cmd, shadowZones[layer]);
             VkRenderPassBeginInfo rpi{VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO};
             rpi.renderPass = shadowRenderPass;
             rpi.framebuffer = shadowFramebuffers[layer];
-            rpi.renderArea.extent = {2048, 2048};
+            rpi.renderArea.extent = {SHADOW_MAP_SIZE, SHADOW_MAP_SIZE};
             VkClearValue cv; cv.depthStencil = {1.0f, 0};
             rpi.clearValueCount = 1; rpi.pClearValues = &cv;
             vkCmdBeginRenderPass(cmd, &rpi, VK_SUBPASS_CONTENTS_INLINE);
             vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, shadowPipeline);
-            VkViewport vp{0, 0, 2048.0f, 2048.0f, 0.0f, 1.0f}; VkRect2D sc{{0, 0}, {2048, 2048}};
+            VkViewport vp{0, 0, (float)SHADOW_MAP_SIZE, (float)SHADOW_MAP_SIZE, 0.0f, 1.0f}; VkRect2D sc{{0, 0}, {SHADOW_MAP_SIZE, SHADOW_MAP_SIZE}};
             vkCmdSetViewport(cmd, 0, 1, &vp); vkCmdSetScissor(cmd, 0, 1, &sc);
-            for (const auto& obj : objects) {
-                if (obj.unlit) continue;
-                for (const auto& sm : obj.submeshes) {
-                    if (!sm.mesh.valid()) continue;
-                    ShadowPC spc{};
-                    spc.model = obj.transform; spc.lightSpace = pendingLights[i].lightSpace;
-                    vkCmdPushConstants(cmd, shadowPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(ShadowPC), &spc);
-                    engine.bindAndDrawMesh_(cmd, sm.mesh);
-                }
+            cullStart = CpuProfiler::nowNs();
+            cullScene_(scene, pendingLights[i].lightSpace, lodView, engine, true, shadowList);
+            cullNs += CpuProfiler::nowNs() - cullStart;
+            ++frameStats.shadowPasses;
+            frameStats.shadowDrawCalls += (uint32_t)shadowList.draws().size();
+            for (const DrawItem& d : shadowList.draws()) {
+                ShadowPC spc{};
+                MeshHandle mesh = subMeshes[d.subMesh].mesh;
+                frameStats.shadowTriangles += lodTriangles(engine, mesh, subMeshes[d.subMesh].lod);
+                spc.model = transforms[d.object] * engine.getMeshDequant(mesh); spc.lightSpace = pendingLights[i].lightSpace;
+                vkCmdPushConstants(cmd, shadowPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(ShadowPC), &spc);
+                engine.bindAndDrawMesh_(cmd, mesh, true, subMeshes[d.subMesh].lod);
             }
             vkCmdEndRenderPass(cmd);
         }
@@ -117,6 +221,7 @@ void RenderingSystem::recordFrame(VkCommandBuffer cmd, uint32_t imageIndex, int
     clears[1].color = {0,0,0,0};
     clears[2].depthStencil = {1.0f, 0};
 
+    profiler.begin(cmd, gbufferZone);
     VkRenderPassBeginInfo rpi{VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO};
     rpi.renderPass = gbuffer.getRenderPass(); rpi.framebuffer = gbuffer.getFramebuffer();
     rpi.renderArea.extent = ext; rpi.clearValueCount = (uint32_t)clears.size(); rpi.pClearValues = clears.data();
@@ -124,21 +229,33 @@ void RenderingSystem::recordFrame(VkCommandBuffer cmd, uint32_t imageIndex, int
     vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, geomPipeline);
     VkViewport vp{0,0,(float)ext.width,(float)ext.height, 0.0f, 1.0f}; VkRect2D sc{{0,0}, ext};
     vkCmdSetViewport(cmd, 0, 1, &vp); vkCmdSetScissor(cmd, 0, 1, &sc);
-    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, geomPipelineLayout, 0, 1, &geomDescSets[frameIndex], 0, nullptr);
-    for (const auto& obj : objects) {
-        for (const auto& sm : obj.submeshes) {
-            if (!sm.mesh.valid()) continue;
-            GeomPC gpc{};
-            gpc.model = obj.transform; gpc.color = obj.unlitColor; gpc.isUnlit = obj.unlit ? 1 : 0;
-            vkCmdPushConstants(cmd, geomPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(GeomPC), &gpc);
-            if (!obj.unlit && sm.texture.valid()) {
-                VkDescriptorSet matSet = engine.getTextureSet(sm.texture);
-                if (matSet != VK_NULL_HANDLE) vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, geomPipelineLayout, 1, 1, &matSet, 0, nullptr);
-            }
-            engine.bindAndDrawMesh_(cmd, sm.mesh);
-        }
+    VkDescriptorSet geomSets[2] = {geomDescSets[frameIndex], engine.getMaterialSet()};
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, geomPipelineLayout, 0, 2, geomSets, 0, nullptr);
+    const auto& unlitColors = scene.getUnlitColors();
+    const auto& draws = drawList.draws();
+    for (size_t k = 0; k < draws.size(); ++k) {
+        const DrawItem& d = draws[k];
+        const SceneSubMesh& sm = subMeshes[d.subMesh];
+        bool unlit = (flags[d.object] & SCENE_UNLIT) != 0;
+        const glm::mat3& nm = normalMats[d.object];
+        GeomPC gpc{};
+        gpc.model = transforms[d.object] * engine.getMeshDequant(sm.mesh); gpc.color = unlitColors[d.object];
+        float texIndex = unlit ? 0.0f : (float)engine.getMaterialIndex(sm.texture);
+        gpc.normalMat[0] = glm::vec4(nm[0], unlit ? 1.0f : 0.0f); gpc.normalMat[1] = glm::vec4(nm[1], texIndex); gpc.normalMat[2] = glm::vec4(nm[2], 0.0f);
+        vkCmdPushConstants(cmd, geomPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(GeomPC), &gpc);
+        if (drawJobs[k] != UINT32_MAX) clusterCuller.drawJob(cmd, engine, frameIndex, sm.mesh, drawJobs[k]);
+        else engine.bindAndDrawMesh_(cmd, sm.mesh, false, sm.lod);
+        frameStats.clusterDraws += drawJobs[k] != UINT32_MAX;
+        frameStats.triangles += lodTriangles(engine, sm.mesh, sm.lod);
     }
+    frameStats.drawCalls = (uint32_t)draws.size();
+    frameStats.cullMs = (double)cullNs * 1e-6;
     vkCmdEndRenderPass(cmd);
+    profiler.end(cmd);
+
+    LightVariant variant = selectLightVariant_(cnt);
+    frameStats.lightVariant = variant;
+    profiler.begin(cmd, lightZones[variant]);
 
     std::array<VkClearValue, 1> lightClears{};
     lightClears[0].color = {0.02f, 0.02f, 0.05f, 1.0f};
@@ -146,25 +263,109 @@ void RenderingSystem::recordFrame(VkCommandBuffer cmd, uint32_t imageIndex, int
     lrpi.renderPass = lightRenderPass; lrpi.framebuffer = lightFramebuffers[imageIndex];
     lrpi.renderArea.extent = ext; lrpi.clearValueCount = 1; lrpi.pClearValues = lightClears.data();
     vkCmdBeginRenderPass(cmd, &lrpi, VK_SUBPASS_CONTENTS_INLINE);
-    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, lightPipeline);
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, lightPipelines[variant]);
     vkCmdSetViewport(cmd, 0, 1, &vp); vkCmdSetScissor(cmd, 0, 1, &sc);
     vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, lightPipelineLayout, 0, 1, &lightDescSets[frameIndex], 0, nullptr);
     vkCmdDraw(cmd, 3, 1, 0, 0);
     vkCmdEndRenderPass(cmd);
+    profiler.end(cmd);
+}
+
+// Модули читаются заново мимо библиотеки шейдеров; если SPIR-V не грузится или
+// конвейер не создаётся, остаётся старый
+void RenderingSystem::reloadShaders(Engine& engine, const std::vector<std::string>& spvPaths) {
+    auto touched = [&](const char* a, const char* b) {
+        for (const auto& p : spvPaths) if (p == a || (b && p == b)) return true;
+        return false;
+    };
+    for (const auto& p : spvPaths) engine.invalidateShader(p);
+    auto start = std::chrono::steady_clock::now();
+    int rebuilt = 0;
+    try {
+        if (touched("shaders/gbuffer.vert.spv", "shaders/gbuffer.frag.spv")) {
+            if (VkPipeline p = buildGeomPipeline_(engine)) { engine.retire(VK_OBJECT_TYPE_PIPELINE, geomPipeline); geomPipeline = p; ++rebuilt; }
+        }
+        if (touched("shaders/shadows.vert.spv", nullptr)) {
+            if (VkPipeline p = buildShadowPipeline_(engine)) { engine.retire(VK_OBJECT_TYPE_PIPELINE, shadowPipeline); shadowPipeline = p; ++rebuilt; }
+        }
+        if (touched("shaders/lighting.vert.spv", "shaders/lighting.frag.spv")) {
+            std::array<VkPipeline, LIGHT_VARIANT_COUNT> old = lightPipelines;
+            if (buildLightPipelines_(engine, lightPipelines)) {
+                for (auto p : old) engine.retire(VK_OBJECT_TYPE_PIPELINE, p);
+                rebuilt += LIGHT_VARIANT_COUNT;
+            }
+        }
+        if (touched("shaders/cull.comp.spv", nullptr) && clusterCuller.reloadPipeline(engine)) ++rebuilt;
+    } catch (const std::exception& e) {
+        std::cerr << "shader reload failed: " << e.what() << "\n";
+    }
+    if (rebuilt == 0) return;
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "shader reload: " << rebuilt << " pipelines rebuilt in " << ms << " ms\n";
+}
+
+const char* RenderingSystem::lightVariantName(LightVariant v) {
+    return v >= 0 && v < LIGHT_VARIANT_COUNT ? LIGHT_VARIANT_NAMES[v] : "unknown";
+}
+
+// Вариант без теней, если ни один активный источник их не отбрасывает,
+// иначе — ядро PCF выбранного радиуса
+RenderingSystem::LightVariant RenderingSystem::selectLightVariant_(int lightCount) const {
+    bool anyShadows = false;
+    for (int i = 0; i < lightCount; ++i)
+        if (pendingLights[i].params2.x > 0.5f) { anyShadows = true; break; }
+    if (!anyShadows) return LIGHT_NO_SHADOWS;
+    return (LightVariant)(LIGHT_PCF_1x1 + shadowFilterRadius);
+}
+
+void RenderingSystem::registerProfilerZones_(GpuProfiler& profiler) {
+    cullZone = profiler.zone("cull");
+    for (uint32_t i = 0; i < SHADOW_LAYERS; ++i) shadowZones[i] = profiler.zone("shadow" + std::to_string(i));
+    gbufferZone = profiler.zone("gbuffer");
+    for (int v = 0; v < LIGHT_VARIANT_COUNT; ++v) lightZones[v] = profiler.zone(std::string("lighting/") + LIGHT_VARIANT_NAMES[v]);
+}
+
+// Линейный проход по SoA-массивам сцены: сфера каждого сабмеша против фрустума.
+// Для видимых сабмешей заодно обновляется LOD.
+void RenderingSystem::cullScene_(Scene& scene, const glm::mat4& viewProj, const LodView& lodView, const Engine& engine, bool skipUnlit, RenderList& out) const {
+    Frustum fr = extractFrustum(viewProj);
+    const auto& transforms = scene.getTransforms();
+    const auto& flags = scene.getFlags();
+    const auto& ranges = scene.getRanges();
+    const auto& subMeshes = scene.getSubMeshes();
+    out.clear();
+    for (uint32_t o = 0; o < (uint32_t)scene.size(); ++o) {
+        if (skipUnlit && (flags[o] & SCENE_UNLIT)) continue;
+        const glm::mat4& m = transforms[o];
+        float scale = maxScale(m);
+        const SubMeshRange& r = ranges[o];
+        for (uint32_t i = r.first; i < r.first + r.count; ++i) {
+            const SceneSubMesh& sm = subMeshes[i];
+            if (!engine.alive(sm.mesh)) continue;
+            glm::vec3 c = glm::vec3(m * glm::vec4(glm::vec3(sm.bounds), 1.0f));
+            float r = sm.bounds.w * scale;
+            if (!sphereVisible(fr, c, r)) continue;
+            // Расстояние до ближайшей точки сферы; камера внутри — всегда LOD0
+            float dist = glm::length(c - lodView.eye) - r;
+            uint8_t lod = dist > 1e-4f ? LodSelection::select(&engine.getMeshLod(sm.mesh, 0), engine.getMeshLodCount(sm.mesh), lodView.pixelScale * scale / dist, sm.lod) : 0;
+            if (lod != sm.lod) scene.setSubMeshLod(i, lod);
+            out.push({o, i});
+        }
+    }
 }
 
 void RenderingSystem::createShadowResources_(Engine& engine) {
     VkDevice dev = engine.getDevice();
     VkFormat depthFmt = engine.findDepthFormat();
-    engine.createImage(2048, 2048, 4, depthFmt, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, shadowImage, shadowMemory);
-    engine.transitionLayout(shadowImage, 4, depthFmt, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
-    shadowArrayView = engine.createImageView(shadowImage, depthFmt, VK_IMAGE_ASPECT_DEPTH_BIT, 0, 4, VK_IMAGE_VIEW_TYPE_2D_ARRAY);
-    shadowLayerViews.resize(4);
-    for(int i=0; i<4; ++i) shadowLayerViews[i] = engine.createImageView(shadowImage, depthFmt, VK_IMAGE_ASPECT_DEPTH_BIT, i, 1, VK_IMAGE_VIEW_TYPE_2D);
+    engine.createImage(SHADOW_MAP_SIZE, SHADOW_MAP_SIZE, SHADOW_LAYERS, depthFmt, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, shadowImage, shadowMemory);
+    engine.transitionLayout(shadowImage, SHADOW_LAYERS, depthFmt, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+    shadowArrayView = engine.createImageView(shadowImage, depthFmt, VK_IMAGE_ASPECT_DEPTH_BIT, 0, SHADOW_LAYERS, VK_IMAGE_VIEW_TYPE_2D_ARRAY);
+    shadowLayerViews.resize(SHADOW_LAYERS);
+    for(uint32_t i=0; i<SHADOW_LAYERS; ++i) shadowLayerViews[i] = engine.createImageView(shadowImage, depthFmt, VK_IMAGE_ASPECT_DEPTH_BIT, i, 1, VK_IMAGE_VIEW_TYPE_2D);
     VkSamplerCreateInfo si{VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO};
     si.magFilter = VK_FILTER_LINEAR; si.minFilter = VK_FILTER_LINEAR; si.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
     si.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE; si.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE; si.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
-    vkCreateSampler(dev, &si, nullptr, &shadowSampler);
+    shadowSampler = engine.getSampler(si);
     VkAttachmentDescription att{};
     att.format = depthFmt; att.samples = VK_SAMPLE_COUNT_1_BIT; att.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR; att.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
     att.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED; att.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
@@ -176,10 +377,10 @@ void RenderingSystem::createShadowResources_(Engine& engine) {
     VkRenderPassCreateInfo rpci{VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO};
     rpci.attachmentCount = 1; rpci.pAttachments = &att; rpci.subpassCount = 1; rpci.pSubpasses = &subpass; rpci.dependencyCount = 2; rpci.pDependencies = deps;
     vkCreateRenderPass(dev, &rpci, nullptr, &shadowRenderPass);
-    shadowFramebuffers.resize(4);
-    for(int i=0; i<4; ++i) {
+    shadowFramebuffers.resize(SHADOW_LAYERS);
+    for(uint32_t i=0; i<SHADOW_LAYERS; ++i) {
         VkFramebufferCreateInfo fci{VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO};
-        fci.renderPass = shadowRenderPass; fci.attachmentCount = 1; fci.pAttachments = &shadowLayerViews[i]; fci.width = 2048; fci.height = 2048; fci.layers = 1;
+        fci.renderPass = shadowRenderPass; fci.attachmentCount = 1; fci.pAttachments = &shadowLayerViews[i]; fci.width = SHADOW_MAP_SIZE; fci.height = SHADOW_MAP_SIZE; fci.layers = 1;
         vkCreateFramebuffer(dev, &fci, nullptr, &shadowFramebuffers[i]);
     }
 }
@@ -190,12 +391,16 @@ void RenderingSystem::createShadowPipeline_(Engine& engine) {
     VkPipelineLayoutCreateInfo plci{VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
     plci.pushConstantRangeCount = 1; plci.pPushConstantRanges = &pcr;
     vkCreatePipelineLayout(dev, &plci, nullptr, &shadowPipelineLayout);
+    shadowPipeline = buildShadowPipeline_(engine);
+}
+
+VkPipeline RenderingSystem::buildShadowPipeline_(Engine& engine) {
     auto vsStage = loadShader_(engine, "shaders/shadows.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
-    auto bindDesc = Vertex::getBindingDesc();
-    auto attrDescs = Vertex::getAttrDescs();
+    // Тени читают только поток позиций (binding 0)
+    auto layout = VertexLayout::get(engine.getVertexFormat());
     VkPipelineVertexInputStateCreateInfo vi{VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO};
-    vi.vertexBindingDescriptionCount = 1; vi.pVertexBindingDescriptions = &bindDesc;
-    vi.vertexAttributeDescriptionCount = 1; vi.pVertexAttributeDescriptions = &attrDescs[0];
+    vi.vertexBindingDescriptionCount = 1; vi.pVertexBindingDescriptions = &layout.bindings[0];
+    vi.vertexAttributeDescriptionCount = 1; vi.pVertexAttributeDescriptions = &layout.attrs[0];
     VkPipelineInputAssemblyStateCreateInfo ia{VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO};
     ia.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
     VkPipelineViewportStateCreateInfo vpState{VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO};
@@ -211,8 +416,9 @@ void RenderingSystem::createShadowPipeline_(Engine& engine) {
     dynState.dynamicStateCount = 2; dynState.pDynamicStates = dyn;
     VkGraphicsPipelineCreateInfo gci{VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO};
     gci.stageCount = 1; gci.pStages = &vsStage; gci.pVertexInputState = &vi; gci.pInputAssemblyState = &ia; gci.pViewportState = &vpState; gci.pRasterizationState = &rast; gci.pMultisampleState = &ms; gci.pDepthStencilState = &ds; gci.pDynamicState = &dynState; gci.layout = shadowPipelineLayout; gci.renderPass = shadowRenderPass;
-    vkCreateGraphicsPipelines(dev, VK_NULL_HANDLE, 1, &gci, nullptr, &shadowPipeline);
-    vkDestroyShaderModule(dev, vsStage.module, nullptr);
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    vkCreateGraphicsPipelines(engine.getDevice(), engine.getPipelineCache(), 1, &gci, nullptr, &pipeline);
+    return pipeline;
 }
 
 void RenderingSystem::createGeomPipeline_(Engine& engine) {
@@ -226,18 +432,28 @@ void RenderingSystem::createGeomPipeline_(Engine& engine) {
     VkPipelineLayoutCreateInfo plci{VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
     plci.setLayoutCount = 2; plci.pSetLayouts = setLayouts; plci.pushConstantRangeCount = 1; plci.pPushConstantRanges = &pcr;
     vkCreatePipelineLayout(dev, &plci, nullptr, &geomPipelineLayout);
+    geomPipeline = buildGeomPipeline_(engine);
+}
+
+VkPipeline RenderingSystem::buildGeomPipeline_(Engine& engine) {
     auto vsStage = loadShader_(engine, "shaders/gbuffer.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
     auto fsStage = loadShader_(engine, "shaders/gbuffer.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+    // constant_id = 0: сжатый формат вершины (декод октаэдрической нормали)
+    VkBool32 packedVertex = engine.getVertexFormat() == VertexFormat::Packed ? VK_TRUE : VK_FALSE;
+    VkSpecializationMapEntry specEntry{0, 0, sizeof(VkBool32)};
+    VkSpecializationInfo specInfo{1, &specEntry, sizeof(VkBool32), &packedVertex};
+    vsStage.pSpecializationInfo = &specInfo;
     VkPipelineShaderStageCreateInfo stages[] = {vsStage, fsStage};
-    auto bindDesc = Vertex::getBindingDesc(); auto attrDesc = Vertex::getAttrDescs();
+    auto layout = VertexLayout::get(engine.getVertexFormat());
     VkPipelineVertexInputStateCreateInfo vi{VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO};
-    vi.vertexBindingDescriptionCount = 1; vi.pVertexBindingDescriptions = &bindDesc; vi.vertexAttributeDescriptionCount = (uint32_t)attrDesc.size(); vi.pVertexAttributeDescriptions = attrDesc.data();
+    vi.vertexBindingDescriptionCount = (uint32_t)layout.bindings.size(); vi.pVertexBindingDescriptions = layout.bindings.data();
+    vi.vertexAttributeDescriptionCount = (uint32_t)layout.attrs.size(); vi.pVertexAttributeDescriptions = layout.attrs.data();
     VkPipelineInputAssemblyStateCreateInfo ia{VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO};
     ia.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
     VkPipelineViewportStateCreateInfo vpState{VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO};
     vpState.viewportCount = vpState.scissorCount = 1;
     VkPipelineRasterizationStateCreateInfo rast{VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO};
-    rast.polygonMode = VK_POLYGON_MODE_FILL; rast.cullMode = VK_CULL_MODE_NONE; rast.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE; rast.lineWidth = 1.0f;
+    rast.polygonMode = VK_POLYGON_MODE_FILL; rast.cullMode = GBUFFER_CULL_MODE; rast.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE; rast.lineWidth = 1.0f;
     VkPipelineMultisampleStateCreateInfo ms{VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO};
     ms.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
     VkPipelineDepthStencilStateCreateInfo ds{VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO};
@@ -251,13 +467,14 @@ void RenderingSystem::createGeomPipeline_(Engine& engine) {
     dynState.dynamicStateCount = 2; dynState.pDynamicStates = dyn;
     VkGraphicsPipelineCreateInfo gci{VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO};
     gci.stageCount = 2; gci.pStages = stages; gci.pVertexInputState = &vi; gci.pInputAssemblyState = &ia; gci.pViewportState = &vpState; gci.pRasterizationState = &rast; gci.pMultisampleState = &ms; gci.pDepthStencilState = &ds; gci.pColorBlendState = &cb; gci.pDynamicState = &dynState; gci.layout = geomPipelineLayout; gci.renderPass = gbuffer.getRenderPass();
-    vkCreateGraphicsPipelines(dev, VK_NULL_HANDLE, 1, &gci, nullptr, &geomPipeline);
-    vkDestroyShaderModule(dev, vsStage.module, nullptr); vkDestroyShaderModule(dev, fsStage.module, nullptr);
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    vkCreateGraphicsPipelines(engine.getDevice(), engine.getPipelineCache(), 1, &gci, nullptr, &pipeline);
+    return pipeline;
 }
 
 void RenderingSystem::createLightRenderPass_(Engine& engine) {
     VkAttachmentDescription colorAtt{};
-    colorAtt.format = engine.getSwapFormat(); colorAtt.samples = VK_SAMPLE_COUNT_1_BIT; colorAtt.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR; colorAtt.storeOp = VK_ATTACHMENT_STORE_OP_STORE; colorAtt.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE; colorAtt.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE; colorAtt.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED; colorAtt.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    colorAtt.format = engine.getSwapFormat(); colorAtt.samples = VK_SAMPLE_COUNT_1_BIT; colorAtt.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR; colorAtt.storeOp = VK_ATTACHMENT_STORE_OP_STORE; colorAtt.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE; colorAtt.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE; colorAtt.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED; colorAtt.finalLayout = engine.getOutputLayout();
     VkAttachmentReference colorRef{0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
     VkSubpassDescription subpass{}; subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS; subpass.colorAttachmentCount = 1; subpass.pColorAttachments = &colorRef;
     std::array<VkSubpassDependency, 2> deps{};
@@ -280,9 +497,13 @@ void RenderingSystem::createLightPipeline_(Engine& engine) {
     VkPipelineLayoutCreateInfo plci{VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
     plci.setLayoutCount = 1; plci.pSetLayouts = &lightDescLayout;
     vkCreatePipelineLayout(dev, &plci, nullptr, &lightPipelineLayout);
+    buildLightPipelines_(engine, lightPipelines);
+}
+
+// Все варианты создаются одним вызовом; при ошибке out не меняется
+bool RenderingSystem::buildLightPipelines_(Engine& engine, std::array<VkPipeline, LIGHT_VARIANT_COUNT>& out) {
     auto vsStage = loadShader_(engine, "shaders/lighting.vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
     auto fsStage = loadShader_(engine, "shaders/lighting.frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
-    VkPipelineShaderStageCreateInfo stages[] = {vsStage, fsStage};
     VkPipelineVertexInputStateCreateInfo vi{VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO};
     VkPipelineInputAssemblyStateCreateInfo ia{VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO};
     ia.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
@@ -299,10 +520,40 @@ void RenderingSystem::createLightPipeline_(Engine& engine) {
     VkDynamicState dyn[] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
     VkPipelineDynamicStateCreateInfo dynState{VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO};
     dynState.dynamicStateCount = 2; dynState.pDynamicStates = dyn;
-    VkGraphicsPipelineCreateInfo gci{VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO};
-    gci.stageCount = 2; gci.pStages = stages; gci.pVertexInputState = &vi; gci.pInputAssemblyState = &ia; gci.pViewportState = &vpState; gci.pRasterizationState = &rast; gci.pMultisampleState = &ms; gci.pColorBlendState = &cb; gci.pDynamicState = &dynState; gci.layout = lightPipelineLayout; gci.renderPass = lightRenderPass;
-    vkCreateGraphicsPipelines(dev, VK_NULL_HANDLE, 1, &gci, nullptr, &lightPipeline);
-    vkDestroyShaderModule(dev, vsStage.module, nullptr); vkDestroyShaderModule(dev, fsStage.module, nullptr);
+    // Константы lighting.frag: constant_id 0 — тени включены, 1 — радиус PCF, 2 — размер теневой карты
+    struct LightSpec {
+        VkBool32 shadows;
+        int32_t pcfRadius;
+        float shadowMapSize;
+    };
+    std::array<LightSpec, LIGHT_VARIANT_COUNT> specData{};
+    std::array<VkSpecializationInfo, LIGHT_VARIANT_COUNT> specInfos{};
+    std::array<std::array<VkPipelineShaderStageCreateInfo, 2>, LIGHT_VARIANT_COUNT> stages{};
+    std::array<VkGraphicsPipelineCreateInfo, LIGHT_VARIANT_COUNT> gcis{};
+    const VkSpecializationMapEntry specEntries[] = {
+        {0, offsetof(LightSpec, shadows), sizeof(VkBool32)},
+        {1, offsetof(LightSpec, pcfRadius), sizeof(int32_t)},
+        {2, offsetof(LightSpec, shadowMapSize), sizeof(float)},
+    };
+    for (int v = 0; v < LIGHT_VARIANT_COUNT; ++v) {
+        specData[v].shadows = v == LIGHT_NO_SHADOWS ? VK_FALSE : VK_TRUE;
+        specData[v].pcfRadius = v == LIGHT_NO_SHADOWS ? 0 : v - LIGHT_PCF_1x1;
+        specData[v].shadowMapSize = (float)SHADOW_MAP_SIZE;
+        specInfos[v].mapEntryCount = 3; specInfos[v].pMapEntries = specEntries;
+        specInfos[v].dataSize = sizeof(LightSpec); specInfos[v].pData = &specData[v];
+        stages[v] = {vsStage, fsStage};
+        stages[v][1].pSpecializationInfo = &specInfos[v];
+        VkGraphicsPipelineCreateInfo& gci = gcis[v];
+        gci.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+        gci.stageCount = 2; gci.pStages = stages[v].data(); gci.pVertexInputState = &vi; gci.pInputAssemblyState = &ia; gci.pViewportState = &vpState; gci.pRasterizationState = &rast; gci.pMultisampleState = &ms; gci.pColorBlendState = &cb; gci.pDynamicState = &dynState; gci.layout = lightPipelineLayout; gci.renderPass = lightRenderPass;
+    }
+    std::array<VkPipeline, LIGHT_VARIANT_COUNT> created{};
+    if (vkCreateGraphicsPipelines(engine.getDevice(), engine.getPipelineCache(), LIGHT_VARIANT_COUNT, gcis.data(), nullptr, created.data()) != VK_SUCCESS) {
+        for (auto p : created) if (p) vkDestroyPipeline(engine.getDevice(), p, nullptr);
+        return false;
+    }
+    out = created;
+    return true;
 }
 
 void RenderingSystem::createFramebuffers_(Engine& engine) {
@@ -362,39 +613,35 @@ void RenderingSystem::createDescriptors_(Engine& engine) {
     }
 }
 
-void RenderingSystem::updateLightDescSets_(Engine& engine) {
+void RenderingSystem::updateLightDescSet_(Engine& engine, int i) {
     VkDevice dev = engine.getDevice();
     VkSampler gbSampler = gbuffer.getSampler();
 
     VkImageView gbViews[3] = {gbuffer.getNormalView(), gbuffer.getAlbedoView(), gbuffer.getDepthView()};
 
-    for (int i = 0; i < Engine::MAX_FRAMES; ++i) {
-        std::array<VkWriteDescriptorSet, 5> writes{};
-        std::array<VkDescriptorImageInfo, 3> imgInfos{};
-        for (int b = 0; b < 3; ++b) {
-            imgInfos[b] = {gbSampler, gbViews[b], VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
-            writes[b].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET; writes[b].dstSet = lightDescSets[i];
-            writes[b].dstBinding = (uint32_t)b; writes[b].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-            writes[b].descriptorCount = 1; writes[b].pImageInfo = &imgInfos[b];
-        }
-        VkDescriptorBufferInfo uboInfo{lightUBOBufs[i], 0, sizeof(LightsUBO)};
-        writes[3].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET; writes[3].dstSet = lightDescSets[i];
-        writes[3].dstBinding = 3; writes[3].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        writes[3].descriptorCount = 1; writes[3].pBufferInfo = &uboInfo;
+    std::array<VkWriteDescriptorSet, 5> writes{};
+    std::array<VkDescriptorImageInfo, 3> imgInfos{};
+    for (int b = 0; b < 3; ++b) {
+        imgInfos[b] = {gbSampler, gbViews[b], VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+        writes[b].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET; writes[b].dstSet = lightDescSets[i];
+        writes[b].dstBinding = (uint32_t)b; writes[b].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        writes[b].descriptorCount = 1; writes[b].pImageInfo = &imgInfos[b];
+    }
+    VkDescriptorBufferInfo uboInfo{lightUBOBufs[i], 0, sizeof(LightsUBO)};
+    writes[3].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET; writes[3].dstSet = lightDescSets[i];
+    writes[3].dstBinding = 3; writes[3].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+    writes[3].descriptorCount = 1; writes[3].pBufferInfo = &uboInfo;
 
-        VkDescriptorImageInfo shadowInfo{shadowSampler, shadowArrayView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
-        writes[4].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET; writes[4].dstSet = lightDescSets[i];
-        writes[4].dstBinding = 4; writes[4].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        writes[4].descriptorCount = 1; writes[4].pImageInfo = &shadowInfo;
+    VkDescriptorImageInfo shadowInfo{shadowSampler, shadowArrayView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+    writes[4].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET; writes[4].dstSet = lightDescSets[i];
+    writes[4].dstBinding = 4; writes[4].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    writes[4].descriptorCount = 1; writes[4].pImageInfo = &shadowInfo;
 
-        vkUpdateDescriptorSets(dev, (uint32_t)writes.size(), writes.data(), 0, nullptr);
-    }
+    vkUpdateDescriptorSets(dev, (uint32_t)writes.size(), writes.data(), 0, nullptr);
 }
 
 VkPipelineShaderStageCreateInfo RenderingSystem::loadShader_(Engine& engine, const std::string& path, VkShaderStageFlagBits stage) {
-    auto code = engine.readFile(path);
-    VkShaderModule sm = engine.createShaderModule(code);
     VkPipelineShaderStageCreateInfo si{VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO};
-    si.stage = stage; si.module = sm; si.pName = "main";
+    si.stage = stage; si.module = engine.getShaderModule(path); si.pName = "main";
     return si;
 }
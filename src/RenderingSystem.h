@@ -4,15 +4,83 @@
 #include "GBuffer.h"
 #include "Light.h"
 #include "Camera.h"
+#include "Scene.h"
+#include "ClusterCuller.h"
 #include <vector>
+#include <array>
+#include <algorithm>
+#include <cmath>
+
+struct DrawItem {
+    uint32_t object;  // dense-индекс объекта в Scene
+    uint32_t subMesh; // индекс в Scene::getSubMeshes()
+};
+
+// Список видимых отрисовок на кадр. Память переиспользуется между кадрами —
+// после прогрева отбор и запись кадра не аллоцируют.
+class RenderList {
+public:
+    void clear() { items.clear(); }
+    void push(DrawItem item) {
+        if (items.size() == items.capacity()) {
+            items.reserve(std::max<size_t>(256, items.capacity() * 2));
+            ++grows;
+        }
+        items.push_back(item);
+    }
+    const std::vector<DrawItem>& draws() const { return items; }
+    int growCount() const { return grows; }
+
+private:
+    std::vector<DrawItem> items;
+    int grows = 0;
+};
 
 class RenderingSystem {
 public:
+    static constexpr uint32_t SHADOW_MAP_SIZE = 2048;
+    static constexpr uint32_t SHADOW_LAYERS = 4;
+    static constexpr int MAX_PCF_RADIUS = 2;
+
+    // Варианты прохода освещения (специализационные константы lighting.frag)
+    enum LightVariant : int {
+        LIGHT_NO_SHADOWS = 0, // ни один активный источник не отбрасывает тень
+        LIGHT_PCF_1x1,
+        LIGHT_PCF_3x3,
+        LIGHT_PCF_5x5,
+        LIGHT_VARIANT_COUNT
+    };
+    // Совпадает с суффиксом зоны GPU-профайлера «lighting/…»
+    static const char* lightVariantName(LightVariant v);
+
     void init(Engine& engine);
     void cleanup(Engine& engine);
     void onResize(Engine& engine);
     void setLights(const std::vector<LightData>& lights) { pendingLights = lights; }
-    void recordFrame(VkCommandBuffer cmd, uint32_t imageIndex, int frameIndex, const Camera& camera, const std::vector<SceneObject>& objects, Engine& engine);
+    // Пересоздаёт конвейеры, использующие перечисленные SPIR-V. Вызывается между
+    // кадрами; старые конвейеры уходят в Engine::retire.
+    void reloadShaders(Engine& engine, const std::vector<std::string>& spvPaths);
+
+    // Меняет сцену только в части состояния LOD сабмешей
+    void recordFrame(VkCommandBuffer cmd, uint32_t imageIndex, int frameIndex, const Camera& camera, Scene& scene, Engine& engine);
+    int drawListGrowCount() const { return drawList.growCount() + shadowList.growCount(); }
+
+    // Счётчики последнего записанного кадра
+    struct FrameStats {
+        uint32_t drawCalls = 0;       // отрисовки G-буфера
+        uint32_t clusterDraws = 0;    // из них через ClusterCuller
+        uint32_t shadowPasses = 0;
+        uint32_t shadowDrawCalls = 0; // по всем слоям теней
+        uint64_t triangles = 0;       // у кластерных отрисовок — до отсечения кластеров
+        uint64_t shadowTriangles = 0;
+        uint32_t lights = 0;
+        double cullMs = 0.0;          // обход сцены: камера и все слои теней
+        LightVariant lightVariant = LIGHT_NO_SHADOWS;
+    };
+    const FrameStats& getFrameStats() const { return frameStats; }
+    // Радиус ядра PCF для теней: 0 — одна выборка, MAX_PCF_RADIUS — 5x5
+    void setShadowFilterRadius(int radius) { shadowFilterRadius = std::clamp(radius, 0, MAX_PCF_RADIUS); }
+    int getShadowFilterRadius() const { return shadowFilterRadius; }
 
 private:
     GBuffer gbuffer;
@@ -35,12 +103,13 @@ private:
     std::vector<VkFramebuffer> lightFramebuffers;
     VkDescriptorSetLayout lightDescLayout = VK_NULL_HANDLE;
     VkPipelineLayout lightPipelineLayout = VK_NULL_HANDLE;
-    VkPipeline lightPipeline = VK_NULL_HANDLE;
+    std::array<VkPipeline, LIGHT_VARIANT_COUNT> lightPipelines{};
     VkDescriptorPool lightDescPool = VK_NULL_HANDLE;
     std::vector<VkDescriptorSet> lightDescSets;
     std::vector<VkBuffer> lightUBOBufs;
     std::vector<VkDeviceMemory> lightUBOMems;
     std::vector<void*> lightUBOMapped;
+    uint32_t staleLightSets = 0; // биты слотов, чьи наборы ссылаются на старые вложения G-буфера
 
     VkRenderPass shadowRenderPass = VK_NULL_HANDLE;
     VkPipelineLayout shadowPipelineLayout = VK_NULL_HANDLE;
@@ -53,6 +122,17 @@ private:
     VkSampler shadowSampler = VK_NULL_HANDLE;
 
     std::vector<LightData> pendingLights;
+    RenderList drawList;
+    RenderList shadowList;
+    ClusterCuller clusterCuller;
+    std::vector<uint32_t> drawJobs; // задание ClusterCuller для каждой отрисовки drawList или UINT32_MAX
+    int shadowFilterRadius = 1;
+    FrameStats frameStats;
+
+    // Зоны GpuProfiler; проход освещения меряется отдельно для каждого варианта
+    uint32_t cullZone = 0, gbufferZone = 0;
+    std::array<uint32_t, SHADOW_LAYERS> shadowZones{};
+    std::array<uint32_t, LIGHT_VARIANT_COUNT> lightZones{};
 
     void createShadowResources_(Engine& engine);
     void createShadowPipeline_(Engine& engine);
@@ -60,8 +140,20 @@ private:
     void createLightRenderPass_(Engine& engine);
     void createLightPipeline_(Engine& engine);
     void createFramebuffers_(Engine& engine);
+    VkPipeline buildShadowPipeline_(Engine& engine);
+    VkPipeline buildGeomPipeline_(Engine& engine);
+    bool buildLightPipelines_(Engine& engine, std::array<VkPipeline, LIGHT_VARIANT_COUNT>& out);
     void createDescriptors_(Engine& engine);
-    void updateLightDescSets_(Engine& engine);
+    void updateLightDescSet_(Engine& engine, int frameIndex);
     void cleanupFramebuffers_(VkDevice device);
+    LightVariant selectLightVariant_(int lightCount) const;
+    void registerProfilerZones_(GpuProfiler& profiler);
+    // Параметры выбора LOD: позиция камеры и пиксели на единицу длины на расстоянии 1
+    struct LodView {
+        glm::vec3 eye;
+        float pixelScale;
+    };
+
+    void cullScene_(Scene& scene, const glm::mat4& viewProj, const LodView& lodView, const Engine& engine, bool skipUnlit, RenderList& out) const;
     VkPipelineShaderStageCreateInfo loadShader_(Engine& engine, const std::string& path, VkShaderStageFlagBits stage);
 };
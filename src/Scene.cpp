@@ -0,0 +1,190 @@
+#include "Scene.h"
+#include <type_traits>
+
+const glm::mat4 Scene::IDENTITY{1.0f};
+
+SceneHandle Scene::add(const SceneObject& obj, const Engine& engine, SceneHandle parent) {
+    uint32_t dense = (uint32_t)world.size();
+    SubMeshRange range{(uint32_t)submeshes.size(), 0};
+    for (const auto& sm : obj.submeshes) {
+        SceneSubMesh s;
+        s.mesh = sm.mesh;
+        s.texture = sm.texture;
+        s.bounds = engine.getMeshBounds(sm.mesh);
+        if (!sm.animTextures.empty()) {
+            s.animFirst = (uint32_t)animTextures.size();
+            s.animCount = (uint32_t)sm.animTextures.size();
+            animTextures.insert(animTextures.end(), sm.animTextures.begin(), sm.animTextures.end());
+        }
+        submeshes.push_back(s);
+        ++range.count;
+    }
+    // Новый объект встаёт в конец, значит после родителя — порядок не нарушается
+    localPos.push_back(obj.position);
+    localRot.push_back(obj.rotation);
+    localScale.push_back(obj.scale);
+    parents.push_back(alive(parent) ? dense_(parent) : NO_PARENT);
+    world.push_back(glm::mat4(1.0f));
+    normalMats.push_back(glm::mat3(1.0f));
+    flags.push_back((uint8_t)((obj.unlit ? SCENE_UNLIT : 0) | (obj.animatable ? SCENE_ANIMATABLE : 0) | SCENE_DIRTY));
+    unlitColors.push_back(obj.unlitColor);
+    animFrames.push_back(obj.animFrame);
+    ranges.push_back(range);
+    anyDirty = true;
+
+    uint32_t slot;
+    if (!freeSlots.empty()) {
+        slot = freeSlots.back();
+        freeSlots.pop_back();
+    } else {
+        slot = (uint32_t)slotToDense.size();
+        slotToDense.push_back(0);
+        slotGeneration.push_back(0);
+    }
+    slotToDense[slot] = dense;
+    denseToSlot.push_back(slot);
+    return SceneHandle{slot, slotGeneration[slot]};
+}
+
+bool Scene::alive(SceneHandle h) const {
+    return h.valid() && h.slot < slotGeneration.size() && slotGeneration[h.slot] == h.generation;
+}
+
+void Scene::remove(SceneHandle h) {
+    if (!alive(h)) return;
+    uint32_t root = dense_(h);
+    // Поддерево целиком лежит правее корня, достаточно одного прохода
+    std::vector<uint8_t> dead(world.size(), 0);
+    std::vector<uint32_t> order;
+    order.reserve(world.size());
+    for (uint32_t i = 0; i < (uint32_t)world.size(); ++i) {
+        dead[i] = (i == root) || (i > root && parents[i] != NO_PARENT && dead[parents[i]]);
+        if (!dead[i]) { order.push_back(i); continue; }
+        const SubMeshRange& r = ranges[i];
+        deadSubMeshes += r.count;
+        for (uint32_t s = r.first; s < r.first + r.count; ++s) deadAnimTextures += submeshes[s].animCount;
+        uint32_t slot = denseToSlot[i];
+        ++slotGeneration[slot];
+        freeSlots.push_back(slot);
+    }
+    reorder_(order);
+    if (deadSubMeshes * 2 > submeshes.size()) compactSubMeshes_();
+}
+
+void Scene::setParent(SceneHandle h, SceneHandle parent) {
+    if (!alive(h)) return;
+    uint32_t d = dense_(h);
+    uint32_t p = alive(parent) ? dense_(parent) : NO_PARENT;
+    if (p == d) return;
+    // Нельзя подвесить объект к собственному потомку
+    for (uint32_t a = p; a != NO_PARENT; a = parents[a])
+        if (a == d) return;
+    parents[d] = p;
+    flags[d] |= SCENE_DIRTY;
+    anyDirty = true;
+    if (p == NO_PARENT || p < d) return;
+
+    // Родитель оказался правее: переносим поддерево в конец, сохраняя
+    // относительный порядок остальных объектов
+    std::vector<uint8_t> inSubtree(world.size(), 0);
+    std::vector<uint32_t> order, subtree;
+    order.reserve(world.size());
+    for (uint32_t i = 0; i < (uint32_t)world.size(); ++i) {
+        inSubtree[i] = (i == d) || (i > d && parents[i] != NO_PARENT && inSubtree[parents[i]]);
+        (inSubtree[i] ? subtree : order).push_back(i);
+    }
+    order.insert(order.end(), subtree.begin(), subtree.end());
+    reorder_(order);
+}
+
+void Scene::clear() {
+    for (uint32_t slot : denseToSlot) {
+        ++slotGeneration[slot];
+        freeSlots.push_back(slot);
+    }
+    localPos.clear(); localRot.clear(); localScale.clear(); parents.clear();
+    world.clear(); normalMats.clear(); flags.clear(); unlitColors.clear();
+    animFrames.clear(); ranges.clear(); denseToSlot.clear();
+    submeshes.clear(); animTextures.clear();
+    deadSubMeshes = deadAnimTextures = 0;
+    anyDirty = false;
+}
+
+void Scene::nextAnimFrame(SceneHandle h) {
+    if (!alive(h)) return;
+    uint32_t d = dense_(h);
+    if (!(flags[d] & SCENE_ANIMATABLE)) return;
+    int frame = ++animFrames[d];
+    const SubMeshRange& r = ranges[d];
+    for (uint32_t i = r.first; i < r.first + r.count; ++i) {
+        auto& sm = submeshes[i];
+        if (sm.animCount > 0) sm.texture = animTextures[sm.animFirst + frame % sm.animCount];
+    }
+}
+
+void Scene::updateTransforms() {
+    if (!anyDirty) return;
+    for (uint32_t i = 0; i < (uint32_t)world.size(); ++i) {
+        uint32_t p = parents[i];
+        bool moved = (flags[i] & SCENE_DIRTY) || (p != NO_PARENT && (flags[p] & SCENE_MOVED));
+        flags[i] &= (uint8_t)~(SCENE_DIRTY | SCENE_MOVED);
+        if (!moved) continue;
+        const glm::vec3& sc = localScale[i];
+        bool uniform = sc.x == sc.y && sc.y == sc.z && (p == NO_PARENT || (flags[p] & SCENE_UNIFORM));
+        glm::mat4 local = glm::mat4_cast(localRot[i]);
+        local[0] *= sc.x;
+        local[1] *= sc.y;
+        local[2] *= sc.z;
+        local[3] = glm::vec4(localPos[i], 1.0f);
+        world[i] = (p != NO_PARENT) ? world[p] * local : local;
+        // При равномерном масштабе обратная-транспонированная совпадает с mat3(world)
+        // с точностью до множителя, а нормаль всё равно нормализуется в шейдере
+        normalMats[i] = uniform ? glm::mat3(world[i]) : glm::transpose(glm::inverse(glm::mat3(world[i])));
+        flags[i] = (uint8_t)((flags[i] & ~SCENE_UNIFORM) | SCENE_MOVED | (uniform ? SCENE_UNIFORM : 0));
+    }
+    anyDirty = false;
+}
+
+// Переставляет плотные массивы в заданном порядке. Индексы, не попавшие в order,
+// выбрасываются. order обязан сохранять топологический порядок.
+void Scene::reorder_(const std::vector<uint32_t>& order) {
+    std::vector<uint32_t> remap(world.size(), NO_PARENT);
+    for (uint32_t n = 0; n < (uint32_t)order.size(); ++n) remap[order[n]] = n;
+    auto permute = [&](auto& v) {
+        std::remove_reference_t<decltype(v)> out;
+        out.reserve(order.size());
+        for (uint32_t o : order) out.push_back(v[o]);
+        v.swap(out);
+    };
+    permute(localPos); permute(localRot); permute(localScale); permute(parents);
+    permute(world); permute(normalMats); permute(flags); permute(unlitColors);
+    permute(animFrames); permute(ranges); permute(denseToSlot);
+    for (auto& p : parents)
+        if (p != NO_PARENT) p = remap[p];
+    for (uint32_t n = 0; n < (uint32_t)denseToSlot.size(); ++n) slotToDense[denseToSlot[n]] = n;
+}
+
+// Пересобирает общие массивы в порядке плотных объектов: выкидывает дыры
+// после удалений и заодно делает обход сабмешей в recordFrame линейным.
+void Scene::compactSubMeshes_() {
+    std::vector<SceneSubMesh> newSubMeshes;
+    std::vector<TextureHandle> newAnimTextures;
+    newSubMeshes.reserve(submeshes.size() - deadSubMeshes);
+    newAnimTextures.reserve(animTextures.size() - deadAnimTextures);
+    for (auto& r : ranges) {
+        uint32_t first = (uint32_t)newSubMeshes.size();
+        for (uint32_t i = r.first; i < r.first + r.count; ++i) {
+            SceneSubMesh s = submeshes[i];
+            if (s.animCount > 0) {
+                uint32_t animFirst = (uint32_t)newAnimTextures.size();
+                newAnimTextures.insert(newAnimTextures.end(), animTextures.begin() + s.animFirst, animTextures.begin() + s.animFirst + s.animCount);
+                s.animFirst = animFirst;
+            }
+            newSubMeshes.push_back(s);
+        }
+        r.first = first;
+    }
+    submeshes.swap(newSubMeshes);
+    animTextures.swap(newAnimTextures);
+    deadSubMeshes = deadAnimTextures = 0;
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "Engine.h"
+#include <glm/gtc/quaternion.hpp>
+#include <vector>
+#include <cstdint>
+
+struct SceneHandle {
+    uint32_t slot = UINT32_MAX;
+    uint32_t generation = 0;
+    bool valid() const { return slot != UINT32_MAX; }
+};
+
+enum SceneFlags : uint8_t {
+    SCENE_UNLIT      = 1 << 0,
+    SCENE_ANIMATABLE = 1 << 1,
+    SCENE_DIRTY      = 1 << 2, // локальная трансформация изменилась
+    SCENE_MOVED      = 1 << 3, // мировая матрица пересчитана (служебный, для детей)
+    SCENE_UNIFORM    = 1 << 4, // мировой масштаб одинаков по осям — матрица нормалей = mat3(world)
+};
+
+struct SubMeshRange {
+    uint32_t first = 0;
+    uint32_t count = 0;
+};
+
+struct SceneSubMesh {
+    MeshHandle mesh;
+    TextureHandle texture;
+    glm::vec4 bounds{0.0f}; // xyz - центр, w - радиус (в пространстве модели)
+    uint32_t animFirst = 0;
+    uint32_t animCount = 0;
+    uint8_t lod = 0; // текущий LOD, хранится ради гистерезиса между кадрами
+};
+
+// Хранилище сцены в виде структуры массивов. Объекты лежат плотно (dense)
+// и отсортированы топологически: родитель всегда стоит раньше детей, поэтому
+// мировые матрицы считаются одним линейным проходом. Внешние SceneHandle
+// остаются валидными при удалении и перестановке других объектов.
+// Сабмеши всех объектов хранятся в одном общем массиве и адресуются диапазонами.
+class Scene {
+public:
+    static constexpr uint32_t NO_PARENT = UINT32_MAX;
+
+    SceneHandle add(const SceneObject& obj, const Engine& engine, SceneHandle parent = {});
+    void remove(SceneHandle h); // удаляет объект вместе с поддеревом
+    bool alive(SceneHandle h) const;
+    void clear();
+
+    // Устаревший хэндл (объект удалён, слот мог быть занят заново) игнорируется
+    void setParent(SceneHandle h, SceneHandle parent);
+    void setLocalPosition(SceneHandle h, const glm::vec3& p) { if (!alive(h)) return; uint32_t d = dense_(h); localPos[d] = p; flags[d] |= SCENE_DIRTY; anyDirty = true; }
+    void setLocalRotation(SceneHandle h, const glm::quat& r) { if (!alive(h)) return; uint32_t d = dense_(h); localRot[d] = r; flags[d] |= SCENE_DIRTY; anyDirty = true; }
+    void setLocalScale(SceneHandle h, const glm::vec3& s) { if (!alive(h)) return; uint32_t d = dense_(h); localScale[d] = s; flags[d] |= SCENE_DIRTY; anyDirty = true; }
+    void setUnlitColor(SceneHandle h, const glm::vec4& c) { if (alive(h)) unlitColors[dense_(h)] = c; }
+    void nextAnimFrame(SceneHandle h);
+    void setSubMeshLod(uint32_t subMesh, uint8_t lod) { submeshes[subMesh].lod = lod; }
+
+    // Пересчитывает мировые матрицы и матрицы нормалей только для изменённых поддеревьев
+    void updateTransforms();
+
+    size_t size() const { return world.size(); }
+    const glm::mat4& getWorld(SceneHandle h) const { return alive(h) ? world[dense_(h)] : IDENTITY; }
+    const std::vector<glm::mat4>& getTransforms() const { return world; }
+    const std::vector<glm::mat3>& getNormalMatrices() const { return normalMats; }
+    const std::vector<uint32_t>& getParents() const { return parents; }
+    const std::vector<uint8_t>& getFlags() const { return flags; }
+    const std::vector<glm::vec4>& getUnlitColors() const { return unlitColors; }
+    const std::vector<SubMeshRange>& getRanges() const { return ranges; }
+    const std::vector<SceneSubMesh>& getSubMeshes() const { return submeshes; }
+
+private:
+    // Плотные массивы, индекс = dense-индекс объекта
+    std::vector<glm::vec3> localPos;
+    std::vector<glm::quat> localRot;
+    std::vector<glm::vec3> localScale;
+    std::vector<uint32_t> parents;
+    std::vector<glm::mat4> world;
+    std::vector<glm::mat3> normalMats;
+    std::vector<uint8_t> flags;
+    std::vector<glm::vec4> unlitColors;
+    std::vector<int> animFrames;
+    std::vector<SubMeshRange> ranges;
+    std::vector<uint32_t> denseToSlot;
+    bool anyDirty = false;
+    static const glm::mat4 IDENTITY; // ответ getWorld на устаревший хэндл
+
+    // Разреженная таблица хэндлов
+    std::vector<uint32_t> slotToDense;
+    std::vector<uint32_t> slotGeneration;
+    std::vector<uint32_t> freeSlots;
+
+    std::vector<SceneSubMesh> submeshes;
+    std::vector<TextureHandle> animTextures;
+    size_t deadSubMeshes = 0;
+    size_t deadAnimTextures = 0;
+
+    uint32_t dense_(SceneHandle h) const { return slotToDense[h.slot]; }
+    void reorder_(const std::vector<uint32_t>& order);
+    void compactSubMeshes_();
+};
@@ -0,0 +1,119 @@
+#include "ShaderWatcher.h"
+#include "CpuProfiler.h"
+#include <set>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+#ifdef _WIN32
+#define popen _popen
+#define pclose _pclose
+#endif
+
+static bool isShaderSource(const std::string& name) {
+    static const char* const exts[] = {".vert", ".frag", ".comp", ".geom", ".tesc", ".tese"};
+    for (const char* ext : exts) {
+        size_t n = std::char_traits<char>::length(ext);
+        if (name.size() > n && name.compare(name.size() - n, n, ext) == 0) return true;
+    }
+    return false;
+}
+
+bool ShaderWatcher::start(const std::string& src, const std::string& out, const std::string& compiler) {
+#ifdef __linux__
+    if (running()) return true;
+    sourceDir = src; outDir = out; glslc = compiler;
+    notifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (notifyFd < 0) return false;
+    // Редакторы сохраняют либо перезаписью, либо через переименование временного файла
+    if (inotify_add_watch(notifyFd, sourceDir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0 || pipe(wakeFd) != 0) {
+        close(notifyFd); notifyFd = -1;
+        return false;
+    }
+    quit = false;
+    worker = std::thread(&ShaderWatcher::run_, this);
+    return true;
+#else
+    (void)src; (void)out; (void)compiler;
+    return false;
+#endif
+}
+
+void ShaderWatcher::stop() {
+#ifdef __linux__
+    if (!running()) return;
+    quit = true;
+    char c = 0;
+    if (write(wakeFd[1], &c, 1) < 0) {}
+    worker.join();
+    close(notifyFd); close(wakeFd[0]); close(wakeFd[1]);
+    notifyFd = wakeFd[0] = wakeFd[1] = -1;
+#endif
+}
+
+void ShaderWatcher::poll(std::vector<Result>& out) {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto& r : ready) out.push_back(std::move(r));
+    ready.clear();
+}
+
+void ShaderWatcher::run_() {
+#ifdef __linux__
+    CpuProfiler::setThreadName("shader watcher");
+    alignas(inotify_event) char buf[4096];
+    std::set<std::string> changed;
+    while (!quit) {
+        // Пока события идут, копим их: одно сохранение даёт несколько уведомлений
+        pollfd fds[2] = {{notifyFd, POLLIN, 0}, {wakeFd[0], POLLIN, 0}};
+        int n = ::poll(fds, 2, changed.empty() ? -1 : 50);
+        if (n < 0 || quit) break;
+        if (n == 0) {
+            for (const auto& name : changed) {
+                Result r = compile_(name);
+                std::lock_guard<std::mutex> lock(mutex);
+                ready.push_back(std::move(r));
+            }
+            changed.clear();
+            continue;
+        }
+        if (!(fds[0].revents & POLLIN)) continue;
+        ssize_t len;
+        while ((len = read(notifyFd, buf, sizeof(buf))) > 0) {
+            for (char* p = buf; p < buf + len; ) {
+                auto* ev = reinterpret_cast<inotify_event*>(p);
+                if (ev->len > 0 && isShaderSource(ev->name)) changed.insert(ev->name);
+                p += sizeof(inotify_event) + ev->len;
+            }
+        }
+    }
+#endif
+}
+
+// Компилирует во временный файл и переименовывает, чтобы главный поток
+// никогда не прочитал наполовину записанный SPIR-V
+ShaderWatcher::Result ShaderWatcher::compile_(const std::string& source) const {
+    CPU_ZONE("glslc");
+    Result r;
+    r.source = source;
+    r.spvPath = outDir + "/" + source + ".spv";
+    std::string tmp = r.spvPath + ".tmp";
+    std::string cmd = "\"" + glslc + "\" \"" + sourceDir + "/" + source + "\" -o \"" + tmp + "\" 2>&1";
+    auto start = std::chrono::steady_clock::now();
+    FILE* p = popen(cmd.c_str(), "r");
+    if (!p) {
+        r.log = "failed to run " + glslc;
+        return r;
+    }
+    char line[512];
+    while (fgets(line, sizeof(line), p)) r.log += line;
+    int status = pclose(p);
+    r.compileMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    r.ok = status == 0 && std::rename(tmp.c_str(), r.spvPath.c_str()) == 0;
+    if (!r.ok) std::remove(tmp.c_str());
+    return r;
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+
+// Следит за исходниками шейдеров и пересобирает изменённые через glslc в
+// фоновом потоке. Готовые SPIR-V кладутся рядом с собранными CMake, главный
+// поток забирает результаты через poll() на границе кадра.
+// Уведомления — inotify, на других платформах start() возвращает false.
+class ShaderWatcher {
+public:
+    struct Result {
+        std::string source;  // имя исходника, например lighting.frag
+        std::string spvPath; // путь, по которому рантайм грузит SPIR-V
+        bool ok = false;
+        double compileMs = 0.0;
+        std::string log;     // вывод glslc при ошибке
+    };
+
+    ~ShaderWatcher() { stop(); }
+
+    bool start(const std::string& sourceDir, const std::string& outDir, const std::string& glslc);
+    void stop();
+    bool running() const { return worker.joinable(); }
+
+    // Забирает накопленные результаты, не блокируясь на компиляции
+    void poll(std::vector<Result>& out);
+
+private:
+    std::string sourceDir, outDir, glslc;
+    std::thread worker;
+    std::mutex mutex;
+    std::vector<Result> ready;
+    std::atomic<bool> quit{false};
+    int notifyFd = -1;
+    int wakeFd[2] = {-1, -1};
+
+    void run_();
+    Result compile_(const std::string& source) const;
+};
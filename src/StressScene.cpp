@@ -0,0 +1,168 @@
+#include "StressScene.h"
+#include <glm/gtc/constants.hpp>
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <random>
+#include <sstream>
+
+// Радиус описанной сферы прототипа в его собственных координатах
+static float prototypeRadius(const Engine& engine, const SceneObject& proto) {
+    float r = 0.0f;
+    for (const auto& sm : proto.submeshes) {
+        glm::vec4 b = engine.getMeshBounds(sm.mesh);
+        r = std::max(r, glm::length(glm::vec3(b)) + b.w);
+    }
+    return r * std::max(proto.scale.x, std::max(proto.scale.y, proto.scale.z));
+}
+
+void StressScene::build(Scene& scene, const Engine& engine, const std::vector<SceneObject>& prototypes, const StressConfig& config) {
+    clear(scene);
+    std::mt19937 rng(config.seed);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    const glm::vec3 lo = config.center - config.extent * 0.5f;
+    const float volume = config.extent.x * config.extent.y * config.extent.z;
+
+    if (config.instances > 0 && !prototypes.empty()) {
+        root = scene.add(SceneObject{}, engine);
+        // Сетка: кубические ячейки, одна на экземпляр; при случайной раскладке
+        // размер экземпляров тот же, чтобы плотность была сравнимой
+        float cell = std::cbrt(volume / (float)config.instances);
+        glm::uvec3 dims = glm::max(glm::uvec3(glm::ceil(config.extent / cell)), glm::uvec3(1));
+        while ((uint64_t)dims.x * dims.y * dims.z < config.instances) ++dims.x;
+        glm::vec3 step = config.extent / glm::vec3(dims);
+        for (uint32_t i = 0; i < config.instances; ++i) {
+            const SceneObject& proto = prototypes[i % prototypes.size()];
+            SceneObject obj = proto;
+            float radius = std::max(prototypeRadius(engine, proto), 1e-4f);
+            float size = 0.4f * cell / radius;
+            if (config.layout == StressLayout::Grid) {
+                glm::uvec3 c{i % dims.x, (i / dims.x) % dims.z, i / (dims.x * dims.z)};
+                obj.position = lo + (glm::vec3(c.x, c.z, c.y) + 0.5f) * step;
+            } else {
+                obj.position = lo + glm::vec3(unit(rng), unit(rng), unit(rng)) * config.extent;
+                obj.rotation = glm::angleAxis(unit(rng) * glm::two_pi<float>(), glm::vec3(0.0f, 1.0f, 0.0f));
+                size *= 0.6f + 0.4f * unit(rng);
+            }
+            obj.scale = proto.scale * size;
+            scene.add(obj, engine, root);
+        }
+        instances = config.instances;
+    }
+
+    lights.clear();
+    phases.clear();
+    float range = std::max(2.0f, 2.0f * std::cbrt(volume / (float)std::max(config.lights, 1u)));
+    for (uint32_t i = 0; i < config.lights; ++i) {
+        glm::vec3 pos = lo + glm::vec3(unit(rng), unit(rng), unit(rng)) * config.extent;
+        // Насыщенный цвет: одна компонента гасится
+        glm::vec3 color(unit(rng), unit(rng), unit(rng));
+        color[i % 3] *= 0.2f;
+        color = color / std::max(color.r, std::max(color.g, color.b));
+        if (unit(rng) < config.spotFraction) {
+            glm::vec3 dir(unit(rng) - 0.5f, -1.0f, unit(rng) - 0.5f);
+            lights.push_back(Light::makeSpot(pos, dir, 20.0f, 30.0f, color, 6.0f, range * 1.5f));
+        } else {
+            lights.push_back(Light::makePoint(pos, color, 4.0f, range));
+        }
+        phases.push_back(unit(rng) * glm::two_pi<float>());
+    }
+}
+
+void StressScene::clear(Scene& scene) {
+    scene.remove(root);
+    root = {};
+    instances = 0;
+    lights.clear();
+    phases.clear();
+}
+
+void StressScene::appendLights(std::vector<LightData>& out, float t) const {
+    for (size_t i = 0; i < lights.size(); ++i) {
+        LightData l = lights[i];
+        l.position.y += 0.5f * std::sin(t * 0.7f + phases[i]);
+        out.push_back(l);
+    }
+}
+
+void StressScene::update(Scene& scene, const StressConfig& config, float t) const {
+    if (config.animate && scene.alive(root)) scene.setLocalPosition(root, glm::vec3(0.0f, 0.05f * std::sin(t * 2.0f), 0.0f));
+}
+
+void StressScene::placeCamera(const StressConfig& config, Camera& camera) {
+    float dist = 0.5f * std::max(config.extent.x, config.extent.z) / std::tan(glm::radians(camera.fovY * 0.5f));
+    camera.position = config.center + glm::vec3(0.0f, config.extent.y * 0.5f, config.extent.z * 0.5f + dist * 0.8f);
+    camera.yaw = -90.0f;
+    camera.pitch = -25.0f;
+}
+
+std::vector<uint32_t> StressSweep::parseList(const std::string& list) {
+    std::vector<uint32_t> out;
+    std::stringstream in(list);
+    std::string item;
+    while (std::getline(in, item, ','))
+        if (!item.empty()) out.push_back((uint32_t)std::stoul(item));
+    return out;
+}
+
+void StressSweep::init(const std::vector<uint32_t>& instanceCounts, const std::vector<uint32_t>& lightCounts, uint32_t frames, uint32_t warmupFrames) {
+    steps.clear();
+    for (uint32_t n : instanceCounts.empty() ? std::vector<uint32_t>{0} : instanceCounts)
+        for (uint32_t m : lightCounts.empty() ? std::vector<uint32_t>{0} : lightCounts)
+            steps.push_back({n, m});
+    framesPerStep = std::max(frames, 1u);
+    warmup = std::min(warmupFrames, framesPerStep - 1);
+    results.assign(steps.size(), Accum{});
+}
+
+void StressSweep::addFrame(uint64_t frame, double cpuMs, double sceneMs, const RenderingSystem::FrameStats& stats) {
+    if (!measured_(frame)) return;
+    Accum& a = results[stepIndex_(frame)];
+    ++a.frames;
+    a.cpuMs += cpuMs;
+    a.sceneMs += sceneMs;
+    a.cullMs += stats.cullMs;
+    a.drawCalls += stats.drawCalls;
+    a.shadowDrawCalls += stats.shadowDrawCalls;
+    a.triangles += stats.triangles;
+    a.shadowTriangles += stats.shadowTriangles;
+    a.lights += stats.lights;
+    a.lightVariant = stats.lightVariant;
+}
+
+void StressSweep::addGpu(uint64_t frame, double ms) {
+    if (!measured_(frame)) return;
+    Accum& a = results[stepIndex_(frame)];
+    ++a.gpuFrames;
+    a.gpuMs += ms;
+}
+
+bool StressSweep::writeCsv(const std::string& path, const char* layout) const {
+    std::ofstream out(path, std::ios::trunc);
+    if (!out.is_open()) return false;
+    out << "layout,instances,lights,frames,cpu_ms,gpu_ms,scene_ms,cull_ms,draw_calls,shadow_draw_calls,triangles,shadow_triangles,active_lights,light_variant\n";
+    out << std::fixed << std::setprecision(4);
+    for (size_t i = 0; i < steps.size(); ++i) {
+        const Accum& a = results[i];
+        double n = std::max(a.frames, 1u);
+        out << layout << ',' << steps[i].instances << ',' << steps[i].lights << ',' << a.frames << ','
+            << a.cpuMs / n << ',' << (a.gpuFrames ? a.gpuMs / a.gpuFrames : 0.0) << ',' << a.sceneMs / n << ',' << a.cullMs / n << ','
+            << (double)a.drawCalls / n << ',' << (double)a.shadowDrawCalls / n << ','
+            << (double)a.triangles / n << ',' << (double)a.shadowTriangles / n << ',' << (double)a.lights / n << ','
+            << RenderingSystem::lightVariantName(a.lightVariant) << '\n';
+    }
+    return (bool)out;
+}
+
+void StressSweep::print(std::ostream& out) const {
+    out << "stress sweep (averages after warmup):\n";
+    for (size_t i = 0; i < steps.size(); ++i) {
+        const Accum& a = results[i];
+        double n = std::max(a.frames, 1u);
+        out << "  " << std::setw(7) << steps[i].instances << " inst " << std::setw(3) << steps[i].lights << " lights: "
+            << std::fixed << std::setprecision(3) << "cpu " << a.cpuMs / n << " ms, gpu " << (a.gpuFrames ? a.gpuMs / a.gpuFrames : 0.0)
+            << " ms (scene " << a.sceneMs / n << ", cull " << a.cullMs / n << "), " << (uint64_t)((double)a.drawCalls / n) << " draws, " << (uint64_t)((double)a.triangles / n) << " tris\n";
+    }
+    out << std::defaultfloat;
+}
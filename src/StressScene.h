@@ -0,0 +1,88 @@
+#pragma once
+#include "Scene.h"
+#include "Light.h"
+#include "Camera.h"
+#include "RenderingSystem.h"
+#include <ostream>
+#include <string>
+#include <vector>
+
+enum class StressLayout { Grid, Random };
+
+struct StressConfig {
+    uint32_t instances = 0;
+    uint32_t lights = 0;
+    StressLayout layout = StressLayout::Grid;
+    glm::vec3 center = {0.0f, 3.5f, 0.0f};
+    glm::vec3 extent = {22.0f, 6.0f, 8.0f}; // размер области, по умолчанию — неф Sponza
+    float spotFraction = 0.25f;             // доля прожекторов среди источников
+    uint32_t seed = 1;
+    bool animate = false;                   // корень покачивается: все экземпляры пересчитываются каждый кадр
+};
+
+// Процедурная нагрузка поверх сцены: экземпляры прототипов сеткой или
+// вразброс и точечные/прожекторные источники без теней. Экземпляры висят
+// под общим пустым корнем, поэтому снимаются одним Scene::remove.
+// При одинаковом seed раскладка одна и та же.
+class StressScene {
+public:
+    void build(Scene& scene, const Engine& engine, const std::vector<SceneObject>& prototypes, const StressConfig& config);
+    void clear(Scene& scene);
+    // Дописывает источники нагрузки; t — время сцены, источники слегка покачиваются
+    void appendLights(std::vector<LightData>& out, float t) const;
+    // При config.animate сдвигает общий корень, помечая всё поддерево грязным
+    void update(Scene& scene, const StressConfig& config, float t) const;
+    size_t instanceCount() const { return instances; }
+
+    // Неподвижная камера, которая видит всю область
+    static void placeCamera(const StressConfig& config, Camera& camera);
+
+private:
+    SceneHandle root;
+    size_t instances = 0;
+    std::vector<LightData> lights;
+    std::vector<float> phases;
+};
+
+// Перебор конфигураций: декартово произведение списков числа экземпляров и
+// источников, по framesPerStep кадров на шаг. Первые warmup кадров шага (сборка
+// сцены, прогрев кэшей) в среднее не идут.
+class StressSweep {
+public:
+    struct Step {
+        uint32_t instances;
+        uint32_t lights;
+    };
+
+    // "100,1000,10000" -> {100, 1000, 10000}
+    static std::vector<uint32_t> parseList(const std::string& list);
+
+    void init(const std::vector<uint32_t>& instanceCounts, const std::vector<uint32_t>& lightCounts, uint32_t framesPerStep, uint32_t warmup);
+    uint64_t totalFrames() const { return (uint64_t)steps.size() * framesPerStep; }
+    bool stepStarts(uint64_t frame) const { return frame % framesPerStep == 0; }
+    const Step& step(uint64_t frame) const { return steps[stepIndex_(frame)]; }
+
+    // sceneMs — Scene::updateTransforms кадра
+    void addFrame(uint64_t frame, double cpuMs, double sceneMs, const RenderingSystem::FrameStats& stats);
+    void addGpu(uint64_t frame, double ms);
+
+    // Строка на шаг: средние по кадрам после прогрева
+    bool writeCsv(const std::string& path, const char* layout) const;
+    void print(std::ostream& out) const;
+
+private:
+    struct Accum {
+        uint32_t frames = 0, gpuFrames = 0;
+        double cpuMs = 0.0, gpuMs = 0.0, sceneMs = 0.0, cullMs = 0.0;
+        uint64_t drawCalls = 0, shadowDrawCalls = 0, triangles = 0, shadowTriangles = 0, lights = 0;
+        RenderingSystem::LightVariant lightVariant = RenderingSystem::LIGHT_NO_SHADOWS; // последнего кадра шага
+    };
+
+    std::vector<Step> steps;
+    std::vector<Accum> results;
+    uint32_t framesPerStep = 1;
+    uint32_t warmup = 0;
+
+    size_t stepIndex_(uint64_t frame) const { return std::min<size_t>((size_t)(frame / framesPerStep), steps.size() - 1); }
+    bool measured_(uint64_t frame) const { return frame / framesPerStep < steps.size() && frame % framesPerStep >= warmup; }
+};
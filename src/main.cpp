@@ -1,8 +1,17 @@
 #include "Engine.h"
 #include "RenderingSystem.h"
+#include "Scene.h"
 #include "Light.h"
 #include "Camera.h"
 #include "Input.h"
+#include "AllocCounter.h"
+#include "MeshOptimizer.h"
+#include "ShaderWatcher.h"
+#include "CpuProfiler.h"
+#include "Benchmark.h"
+#include "StressScene.h"
+#include "GoldenTest.h"
+#include "FrameLimiter.h"
 
 #define TINYOBJLOADER_IMPLEMENTATION
 #include <tiny_obj_loader.h>
@@ -12,6 +21,7 @@
 #include <unordered_map>
 #include <algorithm>
 #include <cmath>
+#include <iostream>
 
 namespace fs = std::filesystem;
 
@@ -19,7 +29,7 @@ struct FallingFlashlight {
     glm::vec3 position;
     glm::vec3 velocity;
     glm::vec3 color;
-    SceneObject object;
+    SceneHandle object;
 };
 
 static std::string normSlashes(std::string p) {
@@ -38,7 +48,14 @@ static std::string findTexture(const std::string& name, const fs::path& baseDir)
     return {};
 }
 
-static SceneObject loadOBJ(Engine& engine, const std::string& objPath, bool animatable = false) {
+struct MeshImportOptions {
+    bool optimize = true; // порядок индексов/вершин под кэш и овердрау
+    bool lods = true;     // цепочка упрощённых LOD
+    bool meshlets = true; // кластеры для GPU-отсечения
+};
+
+static SceneObject loadOBJ(Engine& engine, const std::string& objPath, bool animatable = false, const MeshImportOptions& opts = {}) {
+    CPU_ZONE("loadOBJ");
     fs::path basePath = fs::path(objPath).parent_path();
     tinyobj::ObjReaderConfig cfg;
     cfg.mtl_search_path = basePath.string();
@@ -61,28 +78,70 @@ static SceneObject loadOBJ(Engine& engine, const std::string& objPath, bool anim
     };
     SceneObject obj;
     obj.animatable = animatable;
+    // Вершины OBJ склеиваются по тройке индексов (позиция, нормаль, UV)
+    struct IndexKey {
+        int v, n, t;
+        bool operator==(const IndexKey& o) const { return v == o.v && n == o.n && t == o.t; }
+    };
+    struct IndexKeyHash {
+        size_t operator()(const IndexKey& k) const {
+            size_t h = std::hash<int>()(k.v);
+            h ^= std::hash<int>()(k.n) + 0x9e3779b9 + (h << 6) + (h >> 2);
+            h ^= std::hash<int>()(k.t) + 0x9e3779b9 + (h << 6) + (h >> 2);
+            return h;
+        }
+    };
+    struct Batch {
+        std::vector<Vertex> verts;
+        std::vector<uint32_t> inds;
+        std::unordered_map<IndexKey, uint32_t, IndexKeyHash> remap;
+    };
     for (const auto& shape : shapes) {
-        std::unordered_map<int, std::pair<std::vector<Vertex>, std::vector<uint32_t>>> batches;
+        std::unordered_map<int, Batch> batches;
         size_t off = 0;
         for (size_t f = 0; f < shape.mesh.num_face_vertices.size(); ++f) {
             int matID = shape.mesh.material_ids.empty() ? -1 : shape.mesh.material_ids[f];
-            auto& [verts, inds] = batches[matID];
+            auto& b = batches[matID];
             for (int v = 0; v < 3; ++v) {
                 tinyobj::index_t idx = shape.mesh.indices[off + v];
-                Vertex vert{};
-                vert.pos = {attrib.vertices[3*idx.vertex_index+0], attrib.vertices[3*idx.vertex_index+1], attrib.vertices[3*idx.vertex_index+2]};
-                if (idx.normal_index >= 0) vert.normal = {attrib.normals[3*idx.normal_index+0], attrib.normals[3*idx.normal_index+1], attrib.normals[3*idx.normal_index+2]};
-                if (idx.texcoord_index >= 0) vert.texCoord = {attrib.texcoords[2*idx.texcoord_index+0], 1.0f - attrib.texcoords[2*idx.texcoord_index+1]};
-                inds.push_back((uint32_t)verts.size());
-                verts.push_back(vert);
+                auto [it, inserted] = b.remap.try_emplace(IndexKey{idx.vertex_index, idx.normal_index, idx.texcoord_index}, (uint32_t)b.verts.size());
+                if (inserted) {
+                    Vertex vert{};
+                    vert.pos = {attrib.vertices[3*idx.vertex_index+0], attrib.vertices[3*idx.vertex_index+1], attrib.vertices[3*idx.vertex_index+2]};
+                    if (idx.normal_index >= 0) vert.normal = {attrib.normals[3*idx.normal_index+0], attrib.normals[3*idx.normal_index+1], attrib.normals[3*idx.normal_index+2]};
+                    if (idx.texcoord_index >= 0) vert.texCoord = {attrib.texcoords[2*idx.texcoord_index+0], 1.0f - attrib.texcoords[2*idx.texcoord_index+1]};
+                    b.verts.push_back(vert);
+                }
+                b.inds.push_back(it->second);
             }
             off += 3;
         }
-        for (auto& [matID, pair] : batches) {
-            auto& [verts, inds] = pair;
-            if (verts.empty()) continue;
+        for (auto& [matID, b] : batches) {
+            if (b.verts.empty()) continue;
+            if (opts.optimize) {
+                auto before = MeshOptimizer::analyzeVertexCache(b.inds, b.verts.size());
+                MeshOptimizer::optimizeVertexCache(b.inds, b.verts.size());
+                MeshOptimizer::optimizeOverdraw(b.inds, b.verts);
+                MeshOptimizer::optimizeVertexFetch(b.verts, b.inds);
+                auto after = MeshOptimizer::analyzeVertexCache(b.inds, b.verts.size());
+                std::cout << objPath << " [" << shape.name << "/" << matID << "] tris " << b.inds.size() / 3
+                          << " ACMR " << before.acmr << " -> " << after.acmr
+                          << " ATVR " << before.atvr << " -> " << after.atvr << "\n";
+            }
+            std::vector<MeshLod> lods;
+            if (opts.lods) {
+                MeshOptimizer::generateLods(b.verts, b.inds, lods);
+                std::cout << objPath << " [" << shape.name << "/" << matID << "] LODs";
+                for (const auto& l : lods) std::cout << " " << l.indexCount / 3 << " (err " << l.error << ")";
+                std::cout << "\n";
+            }
+            std::vector<Meshlet> meshlets;
+            if (opts.meshlets) {
+                size_t lod0 = lods.empty() ? b.inds.size() : lods[0].indexCount;
+                MeshOptimizer::buildMeshlets(b.verts, b.inds, lod0, meshlets);
+            }
             SubMesh sm;
-            sm.mesh = engine.createMesh(verts, inds);
+            sm.mesh = engine.createMesh(b.verts, b.inds, lods, meshlets);
             sm.texture = getMatTex(matID);
             obj.submeshes.push_back(sm);
         }
@@ -117,136 +176,476 @@ static MeshHandle createCubeMesh(Engine& engine) {
     return engine.createMesh(v, i);
 }
 
-int main() {
-    glfwInit();
-    glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-    GLFWwindow* window = glfwCreateWindow(1280, 720, "Vulkan Deferred", nullptr, nullptr);
+// SKIP_RETURN_CODE теста golden в CMakeLists.txt
+static constexpr int GOLDEN_SKIP_CODE = 77;
+
+static bool hasFlag(int argc, char** argv, const char* flag) {
+    for (int i = 1; i < argc; ++i)
+        if (std::string(argv[i]) == flag) return true;
+    return false;
+}
+
+// Значение флага вида "--frames 120"
+static std::string flagValue(int argc, char** argv, const char* flag, const std::string& fallback) {
+    for (int i = 1; i + 1 < argc; ++i)
+        if (std::string(argv[i]) == flag) return argv[i + 1];
+    return fallback;
+}
+
+// Наборы настроек темпа кадров; переключаются на ходу (O) или --preset.
+// fpsLimit < 0 — частота обновления монитора
+struct PacingPreset {
+    const char* name;
+    VkPresentModeKHR presentMode;
+    int framesInFlight;
+    double fpsLimit;
+};
+
+static const PacingPreset PACING_PRESETS[] = {
+    {"balanced",    VK_PRESENT_MODE_MAILBOX_KHR,   2, 0.0},   // прежнее поведение
+    {"throughput",  VK_PRESENT_MODE_IMMEDIATE_KHR, 3, 0.0},   // максимум кадров, разрывы допустимы
+    {"low-latency", VK_PRESENT_MODE_MAILBOX_KHR,   1, -1.0},  // один кадр в полёте, темп монитора
+    {"power-saver", VK_PRESENT_MODE_FIFO_KHR,      2, 30.0},  // vsync и 30 fps: ноутбук не греется
+};
+
+static VkPresentModeKHR parsePresentMode(const std::string& name, VkPresentModeKHR fallback) {
+    if (name == "fifo") return VK_PRESENT_MODE_FIFO_KHR;
+    if (name == "relaxed") return VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+    if (name == "mailbox") return VK_PRESENT_MODE_MAILBOX_KHR;
+    if (name == "immediate") return VK_PRESENT_MODE_IMMEDIATE_KHR;
+    return fallback;
+}
+
+static const char* presentModeName(VkPresentModeKHR mode) {
+    switch (mode) {
+        case VK_PRESENT_MODE_FIFO_KHR: return "fifo";
+        case VK_PRESENT_MODE_FIFO_RELAXED_KHR: return "relaxed";
+        case VK_PRESENT_MODE_MAILBOX_KHR: return "mailbox";
+        case VK_PRESENT_MODE_IMMEDIATE_KHR: return "immediate";
+        default: return "other";
+    }
+}
+
+static double monitorRefreshRate() {
+    GLFWmonitor* monitor = glfwGetPrimaryMonitor();
+    const GLFWvidmode* mode = monitor ? glfwGetVideoMode(monitor) : nullptr;
+    return mode && mode->refreshRate > 0 ? (double)mode->refreshRate : 60.0;
+}
+
+static void applyPacingPreset(const PacingPreset& p, Engine& engine, FrameLimiter& limiter) {
+    engine.setPresentMode(p.presentMode);
+    engine.setFramesInFlight(p.framesInFlight);
+    limiter.setTargetFps(p.fpsLimit < 0.0 ? monitorRefreshRate() : p.fpsLimit);
+    std::cout << "pacing preset " << p.name << ": present " << presentModeName(p.presentMode) << (engine.isPresentModeSupported(p.presentMode) ? "" : " (unsupported, fifo)")
+              << ", " << p.framesInFlight << " frames in flight, fps limit " << limiter.getTargetFps() << "\n";
+}
+
+int main(int argc, char** argv) {
+    CpuProfiler::setThreadName("main");
+    // --headless: без окна, фиксированное число кадров с шагом 1/60 с,
+    // последний кадр пишется в PNG (--out)
+    const bool headless = hasFlag(argc, argv, "--headless");
+    const uint64_t headlessFrames = std::max(1, std::stoi(flagValue(argc, argv, "--frames", "60")));
+    const std::string headlessOut = flagValue(argc, argv, "--out", "frame.png");
+    // --benchmark: камера и фонарики по сценарию (--bench-script, иначе облёт
+    // по умолчанию) с фиксированным шагом, перцентили времён кадра в --bench-out
+    // --stress: перебор --stress-instances x --stress-lights (списки через
+    // запятую), по --stress-frames кадров на шаг, средние по шагам в --stress-out.
+    // --scene-bench: то же для 1k/10k/100k экземпляров с движущимся корнем —
+    // каждый кадр пересчитывает и обходит всю сцену (scene_ms, cull_ms).
+    // --stress-reload N: раз в N кадров модель (--stress-mesh, иначе
+    // assets/model.obj) грузится заново, прошлая копия удаляется вместе с
+    // мешами и текстурами — проверка destroyMesh/destroyTexture и переиспользования слотов
+    const bool sceneBench = hasFlag(argc, argv, "--scene-bench");
+    const bool stress = hasFlag(argc, argv, "--stress") || sceneBench;
+    // --golden: фиксированные ракурсы сравниваются с эталонами из --golden-dir
+    // (--update-golden перезаписывает их); код возврата 1 при расхождении,
+    // GOLDEN_SKIP_CODE — если эталонов ещё нет
+    const bool golden = hasFlag(argc, argv, "--golden") && !stress;
+    const bool benchmark = hasFlag(argc, argv, "--benchmark") && !stress && !golden;
+    const std::string benchScriptPath = flagValue(argc, argv, "--bench-script", "");
+    const std::string benchOut = flagValue(argc, argv, "--bench-out", "benchmark.json");
+    BenchmarkScript benchScript = benchScriptPath.empty() ? BenchmarkScript::makeDefault() : BenchmarkScript::load(benchScriptPath);
+    StressConfig stressConfig;
+    stressConfig.layout = flagValue(argc, argv, "--stress-layout", "grid") == "random" ? StressLayout::Random : StressLayout::Grid;
+    stressConfig.seed = (uint32_t)std::stoul(flagValue(argc, argv, "--stress-seed", "1"));
+    stressConfig.animate = sceneBench || hasFlag(argc, argv, "--stress-animate");
+    const std::string stressOut = flagValue(argc, argv, "--stress-out", "stress.csv");
+    const uint64_t stressReload = stress ? std::stoull(flagValue(argc, argv, "--stress-reload", "0")) : 0;
+    StressSweep stressSweep;
+    {
+        // Три основных источника всегда в UBO, остальное — нагрузка
+        const uint32_t maxStressLights = MAX_LIGHTS - 3;
+        std::vector<uint32_t> lightCounts = StressSweep::parseList(flagValue(argc, argv, "--stress-lights", "0"));
+        for (uint32_t& m : lightCounts) {
+            if (m <= maxStressLights) continue;
+            std::cerr << "stress: " << m << " lights exceed the UBO limit, using " << maxStressLights << "\n";
+            m = maxStressLights;
+        }
+        stressSweep.init(StressSweep::parseList(flagValue(argc, argv, "--stress-instances", sceneBench ? "1000,10000,100000" : "1000")), lightCounts,
+                         (uint32_t)std::stoul(flagValue(argc, argv, "--stress-frames", "240")), 60);
+    }
+    GoldenRunner goldenRunner;
+    {
+        GoldenRunner::Options opts;
+        opts.dir = flagValue(argc, argv, "--golden-dir", opts.dir);
+        opts.update = hasFlag(argc, argv, "--update-golden");
+        opts.minPsnr = std::stod(flagValue(argc, argv, "--golden-psnr", std::to_string(opts.minPsnr)));
+        goldenRunner.init(GoldenRunner::defaultCases(), opts);
+    }
+    const uint64_t frameLimit = stress ? stressSweep.totalFrames() : golden ? goldenRunner.totalFrames()
+                              : benchmark ? benchScript.frames : headless ? headlessFrames : 0;
+    const double fixedStep = benchmark ? benchScript.timestep : (headless || stress) ? 1.0 / 60.0 : 0.0;
+    // В замерах и проверках ввод не меняет сцену
+    const bool scripted = benchmark || stress || golden;
+    GLFWwindow* window = nullptr;
+    if (!headless) {
+        glfwInit();
+        glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+        window = glfwCreateWindow(1280, 720, "Vulkan Deferred", nullptr, nullptr);
+    }
 
     Input input;
-    input.init(window);
+    if (window) input.init(window);
 
     Engine engine;
     RenderingSystem rs;
-    engine.init(window);
+    engine.setPipelineCacheEnabled(!hasFlag(argc, argv, "--no-pipeline-cache"));
+    // --cpu-device: только lavapipe, даже если есть дискретная видеокарта
+    engine.setCpuDeviceOnly(hasFlag(argc, argv, "--cpu-device"));
+    if (headless) engine.initHeadless(1280, 720);
+    else engine.init(window);
+    // Темп кадров: --preset задаёт набор, отдельные флаги поверх него
+    FrameLimiter frameLimiter;
+    size_t presetIndex = 0;
+    {
+        const std::string presetName = flagValue(argc, argv, "--preset", "");
+        for (size_t i = 0; i < std::size(PACING_PRESETS); ++i)
+            if (presetName == PACING_PRESETS[i].name) presetIndex = i;
+        if (!presetName.empty()) applyPacingPreset(PACING_PRESETS[presetIndex], engine, frameLimiter);
+    }
+    if (hasFlag(argc, argv, "--frames-in-flight")) engine.setFramesInFlight(std::stoi(flagValue(argc, argv, "--frames-in-flight", "2")));
+    if (hasFlag(argc, argv, "--present-mode"))
+        engine.setPresentMode(parsePresentMode(flagValue(argc, argv, "--present-mode", ""), VK_PRESENT_MODE_FIFO_KHR));
+    if (hasFlag(argc, argv, "--swap-images")) engine.setSwapImageCount((uint32_t)std::stoul(flagValue(argc, argv, "--swap-images", "0")));
+    if (hasFlag(argc, argv, "--fps-limit")) frameLimiter.setTargetFps(std::stod(flagValue(argc, argv, "--fps-limit", "0")));
+    if (hasFlag(argc, argv, "--gpu-csv") && !engine.getGpuProfiler().openCsv("gpu_profile.csv"))
+        std::cerr << "cannot open gpu_profile.csv\n";
+    // --packed-vertices: квантованные позиции и UV; по умолчанию полная точность
+    engine.setVertexFormat(hasFlag(argc, argv, "--packed-vertices") ? VertexFormat::Packed : VertexFormat::Full);
+    // Без архива (или с --loose-shaders) шейдеры читаются по одному файлу
+    if (!hasFlag(argc, argv, "--loose-shaders")) engine.loadShaderArchive("shaders/shaders.pak");
     rs.init(engine);
 
+    ShaderWatcher shaderWatcher;
+#if defined(SHADER_SOURCE_DIR) && defined(GLSLC_PATH)
+    if (!headless && !scripted && !hasFlag(argc, argv, "--no-shader-watch") && shaderWatcher.start(SHADER_SOURCE_DIR, "shaders", GLSLC_PATH))
+        std::cout << "watching " << SHADER_SOURCE_DIR << " for shader changes\n";
+#endif
+    std::vector<ShaderWatcher::Result> shaderResults;
+    std::vector<std::string> reloadedShaders;
+
     MeshHandle cubeMesh = createCubeMesh(engine);
-    std::vector<SceneObject> objects;
+    Scene scene;
+    MeshImportOptions importOpts;
+    importOpts.optimize = !hasFlag(argc, argv, "--no-mesh-opt");
+    importOpts.lods = !hasFlag(argc, argv, "--no-lod");
+    importOpts.meshlets = !hasFlag(argc, argv, "--no-meshlets");
 
     std::vector<FallingFlashlight> droppedLights;
     bool fPressedLastFrame = false;
+    bool pPressedLastFrame = false;
+    bool tracePressedLastFrame = false;
+    bool flightKeyLastFrame = false;
+    bool presetKeyLastFrame = false;
 
     const float GRAVITY = -9.81f;
     const float FLOOR_Y = 0.05f;
 
-
     try {
-        auto sponza = loadOBJ(engine, "assets/sponza/sponza.obj", false);
-        sponza.transform = glm::scale(glm::mat4(1.0f), glm::vec3(0.01f));
-        objects.push_back(std::move(sponza));
+        auto sponza = loadOBJ(engine, "assets/sponza/sponza.obj", false, importOpts);
+        sponza.scale = glm::vec3(0.01f);
+        scene.add(sponza, engine);
     } catch (...) {}
 
-    int animIdx = -1;
+    SceneHandle animObj;
     try {
-        auto m2 = loadOBJ(engine, "assets/model2/model.obj", true);
-        m2.transform = glm::mat4(1.0f);
-        animIdx = (int)objects.size();
-        objects.push_back(std::move(m2));
+        auto m2 = loadOBJ(engine, "assets/model2/model.obj", true, importOpts);
+        animObj = scene.add(m2, engine);
     } catch (...) {}
 
-    for (int i=0; i<3; ++i) {
-        SceneObject cubeLight;
+    SceneObject cubeLight;
+    {
         SubMesh sm;
         sm.mesh = cubeMesh;
         sm.texture = engine.createWhiteTexture();
         cubeLight.submeshes.push_back(sm);
         cubeLight.unlit = true;
-        objects.push_back(cubeLight);
+        cubeLight.scale = glm::vec3(0.2f);
+    }
+    SceneHandle lightCubes[3];
+    for (auto& h : lightCubes) h = scene.add(cubeLight, engine);
+    // Прототипы нагрузки: освещённый куб и, если задан, --stress-mesh
+    std::vector<SceneObject> stressPrototypes;
+    StressScene stressScene;
+    if (stress) {
+        SceneObject cube = cubeLight;
+        cube.unlit = false;
+        cube.scale = glm::vec3(1.0f);
+        stressPrototypes.push_back(cube);
+        if (hasFlag(argc, argv, "--stress-mesh")) {
+            try {
+                stressPrototypes.push_back(loadOBJ(engine, flagValue(argc, argv, "--stress-mesh", ""), false, importOpts));
+            } catch (const std::exception& e) {
+                std::cerr << "stress mesh: " << e.what() << "\n";
+            }
+        }
     }
+    // Перезагружаемая копия для --stress-reload
+    const std::string reloadPath = flagValue(argc, argv, "--stress-mesh", "assets/model.obj");
+    SceneObject reloadObj;
+    SceneHandle reloadHandle;
+    uint64_t reloadCount = 0;
+    auto releaseReloadObj = [&]() {
+        if (scene.alive(reloadHandle)) scene.remove(reloadHandle);
+        reloadHandle = {};
+        // Белая текстура общая, её не трогаем; повторное удаление — no-op
+        TextureHandle white = engine.createWhiteTexture();
+        for (const auto& sm : reloadObj.submeshes) {
+            engine.destroyMesh(sm.mesh);
+            if (sm.texture.id != white.id) engine.destroyTexture(sm.texture);
+            for (const auto& t : sm.animTextures)
+                if (t.id != white.id) engine.destroyTexture(t);
+        }
+        reloadObj = {};
+    };
+    std::cout << "samplers: " << engine.getSamplerCount() << " (limit " << engine.getPhysProps().limits.maxSamplerAllocationCount << ")\n";
+
+    auto spawnFlashlight = [&](const glm::vec3& position, const glm::vec3& velocity, const glm::vec3& color) {
+        FallingFlashlight fl;
+        fl.position = position;
+        fl.velocity = velocity;
+        fl.color = color;
+
+        SceneObject obj = cubeLight;
+        obj.unlitColor = glm::vec4(fl.color, 1.0f);
+        obj.position = fl.position;
+        obj.scale = glm::vec3(0.15f);
+        fl.object = scene.add(obj, engine);
+        droppedLights.push_back(fl);
+    };
+
+    // --record-path: ключи пути живой камеры для будущего --bench-script
+    CameraPathRecorder pathRecorder;
+    if (!benchmark && hasFlag(argc, argv, "--record-path")) {
+        std::string recordPath = flagValue(argc, argv, "--record-path", "camera_path.txt");
+        if (pathRecorder.open(recordPath)) std::cout << "recording camera path to " << recordPath << "\n";
+        else std::cerr << "cannot open " << recordPath << "\n";
+    }
+    BenchmarkStats benchStats;
+    if (benchmark) benchStats.reserve(frameLimit);
+    size_t nextSpawn = 0;
+    uint64_t gpuFramesSeen = 0;
 
     Camera camera;
-    double lastTime = glfwGetTime();
-
-    while (!glfwWindowShouldClose(window)) {
-            input.update();
-            if (input.wasResized()) {
-                int w=0, h=0;
-                glfwGetFramebufferSize(window, &w, &h);
-                if (w == 0 || h == 0) continue;
-                engine.recreateSwapchain();
-                rs.onResize(engine);
-                input.clearResized();
+    if (stress) StressScene::placeCamera(stressConfig, camera);
+    // По сценарию время считается от нуля, а не от glfwGetTime — иначе первый dt отрицателен
+    double lastTime = (headless || fixedStep > 0.0 || golden) ? 0.0 : glfwGetTime();
+    std::vector<LightData> allLights;
+    uint64_t frameNumber = 0;
+    bool reportedRenderAllocs = false;
+
+    while (!(window && glfwWindowShouldClose(window)) && (frameLimit == 0 || frameNumber < frameLimit)) {
+            CPU_ZONE("frame");
+            uint64_t frameStartNs = CpuProfiler::nowNs();
+            if (!headless) {
+                CPU_ZONE("input");
+                input.update();
+                if (input.wasResized()) {
+                    int w=0, h=0;
+                    glfwGetFramebufferSize(window, &w, &h);
+                    if (w == 0 || h == 0) continue;
+                    engine.recreateSwapchain();
+                    rs.onResize(engine);
+                    input.clearResized();
+                }
             }
 
-            double now = glfwGetTime();
+            if (golden && goldenRunner.caseStarts(frameNumber)) {
+                const GoldenCase& gc = goldenRunner.currentCase(frameNumber);
+                camera.position = gc.position; camera.yaw = gc.yaw; camera.pitch = gc.pitch;
+                rs.setShadowFilterRadius(gc.pcfRadius);
+                for (const auto& fl : droppedLights) scene.remove(fl.object);
+                droppedLights.clear();
+                for (uint32_t i = 0; i < gc.flashlights; ++i) {
+                    glm::vec3 color(i % 3 == 0 ? 1.0f : 0.3f, i % 3 == 1 ? 1.0f : 0.3f, i % 3 == 2 ? 1.0f : 0.3f);
+                    spawnFlashlight({-6.0f + 2.5f * (float)i, FLOOR_Y, (i % 2) ? 1.5f : -1.5f}, glm::vec3(0.0f), color * 2.0f + 0.5f);
+                }
+            }
+            // Эталонные кадры: время стоит, источники не двигаются
+            double now = golden ? (double)goldenRunner.currentCase(frameNumber).time
+                       : fixedStep > 0.0 ? (double)(frameNumber + 1) * fixedStep : glfwGetTime();
             float dt = (float)(now - lastTime);
             lastTime = now;
-            camera.update(input, dt);
+            if (stress && stressSweep.stepStarts(frameNumber)) {
+                const StressSweep::Step& step = stressSweep.step(frameNumber);
+                stressConfig.instances = step.instances;
+                stressConfig.lights = step.lights;
+                CPU_ZONE("stress build");
+                stressScene.build(scene, engine, stressPrototypes, stressConfig);
+                std::cout << "stress step: " << step.instances << " instances, " << step.lights << " lights\n";
+            }
+            if (stressReload > 0 && frameNumber % stressReload == 0) {
+                CPU_ZONE("stress reload");
+                releaseReloadObj();
+                try {
+                    reloadObj = loadOBJ(engine, reloadPath, false, importOpts);
+                    reloadObj.position = stressConfig.center;
+                    reloadHandle = scene.add(reloadObj, engine);
+                    ++reloadCount;
+                } catch (const std::exception& e) {
+                    std::cerr << "stress reload: " << e.what() << "\n";
+                }
+            }
+            if (benchmark) {
+                benchScript.sampleCamera((float)now, camera);
+            } else if (!stress && !golden) {
+                camera.update(input, dt);
+                pathRecorder.update((float)now, camera);
+            }
 
             // 1. ЛОГИКА АНИМАЦИИ И СПАВНА ФОНАРИКОВ
-            if (input.isKeyDown(GLFW_KEY_U) && animIdx >= 0) objects[animIdx].nextAnimFrame();
+            // В замере ввод не влияет на сцену: фонарики только по расписанию
+            for (; benchmark && nextSpawn < benchScript.spawns.size() && benchScript.spawns[nextSpawn].time <= now; ++nextSpawn) {
+                const auto& sp = benchScript.spawns[nextSpawn];
+                spawnFlashlight(sp.position, sp.velocity, sp.color);
+            }
+            if (!scripted && input.isKeyDown(GLFW_KEY_U) && scene.alive(animObj)) scene.nextAnimFrame(animObj);
 
-            bool fIsDown = input.isKeyDown(GLFW_KEY_F);
+            bool fIsDown = !scripted && input.isKeyDown(GLFW_KEY_F);
             if (fIsDown && !fPressedLastFrame) {
-                FallingFlashlight fl;
-                fl.position = camera.position;
-                fl.velocity = camera.front() * 10.0f;
-                fl.color = glm::vec3((rand()%100)/100.f, (rand()%100)/100.f, (rand()%100)/100.f) * 2.0f + 0.5f;
-
-                SubMesh sm;
-                sm.mesh = cubeMesh;
-                sm.texture = engine.createWhiteTexture();
-                fl.object.submeshes.push_back(sm);
-                fl.object.unlit = true;
-                fl.object.unlitColor = glm::vec4(fl.color, 1.0f);
-                droppedLights.push_back(fl);
+                glm::vec3 color = glm::vec3((rand()%100)/100.f, (rand()%100)/100.f, (rand()%100)/100.f) * 2.0f + 0.5f;
+                spawnFlashlight(camera.position, camera.front() * 10.0f, color);
             }
             fPressedLastFrame = fIsDown;
 
+            // P — следующий размер ядра PCF (1x1 -> 3x3 -> 5x5)
+            bool pIsDown = !scripted && input.isKeyDown(GLFW_KEY_P);
+            if (pIsDown && !pPressedLastFrame)
+                rs.setShadowFilterRadius((rs.getShadowFilterRadius() + 1) % (RenderingSystem::MAX_PCF_RADIUS + 1));
+            pPressedLastFrame = pIsDown;
+
+            // F9 — выгрузить CPU-трассу последних кадров; сцену не меняет, поэтому
+            // работает и в замерах
+            bool traceKeyDown = input.isKeyDown(GLFW_KEY_F9);
+            if (traceKeyDown && !tracePressedLastFrame)
+                std::cout << (CpuProfiler::writeChromeTrace("cpu_trace.json") ? "cpu trace written to cpu_trace.json\n" : "cannot write cpu_trace.json\n");
+            tracePressedLastFrame = traceKeyDown;
+
+            // L — следующее число кадров в полёте (1 -> ... -> MAX_FRAMES -> 1)
+            bool flightKeyDown = !scripted && input.isKeyDown(GLFW_KEY_L);
+            if (flightKeyDown && !flightKeyLastFrame) {
+                const auto& lat = engine.getSubmitToObserved();
+                std::cout << "frames in flight " << engine.getFramesInFlight() << ": submit to observed avg " << lat.avgMs << " ms, max " << lat.maxMs << " ms\n";
+                engine.setFramesInFlight(engine.getFramesInFlight() % Engine::MAX_FRAMES + 1);
+                std::cout << "frames in flight -> " << engine.getFramesInFlight() << "\n";
+            }
+            flightKeyLastFrame = flightKeyDown;
+
+            // O — следующий набор настроек темпа кадров
+            bool presetKeyDown = !scripted && input.isKeyDown(GLFW_KEY_O);
+            if (presetKeyDown && !presetKeyLastFrame) {
+                presetIndex = (presetIndex + 1) % std::size(PACING_PRESETS);
+                applyPacingPreset(PACING_PRESETS[presetIndex], engine, frameLimiter);
+            }
+            presetKeyLastFrame = presetKeyDown;
+
             // 2. ФИЗИКА ФОНАРИКОВ
-            for (auto& fl : droppedLights) {
-                if (fl.position.y > FLOOR_Y) {
-                    fl.velocity.y += GRAVITY * dt;
-                    fl.position += fl.velocity * dt;
-                } else {
-                    fl.position.y = FLOOR_Y;
-                    fl.velocity = glm::vec3(0.0f);
+            {
+                CPU_ZONE("flashlight physics");
+                for (auto& fl : droppedLights) {
+                    if (fl.position.y > FLOOR_Y) {
+                        fl.velocity.y += GRAVITY * dt;
+                        fl.position += fl.velocity * dt;
+                    } else {
+                        fl.position.y = FLOOR_Y;
+                        fl.velocity = glm::vec3(0.0f);
+                    }
+                    scene.setLocalPosition(fl.object, fl.position);
                 }
-                fl.object.transform = glm::translate(glm::mat4(1.0f), fl.position) * glm::scale(glm::mat4(1.0f), glm::vec3(0.15f));
             }
 
             // 3. ПОДГОТОВКА ВСЕХ ИСТОЧНИКОВ СВЕТА (Static + Dropped)
-            std::vector<LightData> allLights;
-            // Основные источники
-            allLights.push_back(Light::makeDirectional({-0.5f, -1.0f, -0.3f}, {1.0f, 0.95f, 0.85f}, 2.0f, true, 0));
-            float px = 3.0f * (float)std::cos(now * 0.5);
-            float pz = 3.0f * (float)std::sin(now * 0.5);
-            allLights.push_back(Light::makePoint({px, 2.5f, pz}, {0.4f, 0.6f, 1.0f}, 5.0f, 10.0f));
-            allLights.push_back(Light::makeSpot({0.0f, 5.0f, 0.0f}, {0.0f, -1.0f, 0.0f}, 15.0f, 25.0f, {1.0f, 0.3f, 0.2f}, 10.0f, 20.0f, true, 1));
-
-            // Добавляем свет от фонариков
-            for (const auto& fl : droppedLights) {
-                allLights.push_back(Light::makePoint(fl.position, fl.color, 8.0f, 12.0f));
+            {
+                CPU_ZONE("build lights");
+                allLights.clear();
+                // Основные источники
+                allLights.push_back(Light::makeDirectional({-0.5f, -1.0f, -0.3f}, {1.0f, 0.95f, 0.85f}, 2.0f, true, 0));
+                float px = 3.0f * (float)std::cos(now * 0.5);
+                float pz = 3.0f * (float)std::sin(now * 0.5);
+                allLights.push_back(Light::makePoint({px, 2.5f, pz}, {0.4f, 0.6f, 1.0f}, 5.0f, 10.0f));
+                allLights.push_back(Light::makeSpot({0.0f, 5.0f, 0.0f}, {0.0f, -1.0f, 0.0f}, 15.0f, 25.0f, {1.0f, 0.3f, 0.2f}, 10.0f, 20.0f, true, 1));
+
+                // Добавляем свет от фонариков
+                for (const auto& fl : droppedLights) {
+                    allLights.push_back(Light::makePoint(fl.position, fl.color, 8.0f, 12.0f));
+                }
+                stressScene.appendLights(allLights, (float)now);
+                stressScene.update(scene, stressConfig, (float)now);
+
+                if (allLights.size() > 64) allLights.resize(64);
+                rs.setLights(allLights);
+
+                // Обновляем визуальные кубики для основных лампочек
+                for(size_t i=0; i<3; ++i) {
+                    if (i + 1 < allLights.size()) { // i+1 так как 0-й свет это солнце
+                        scene.setLocalPosition(lightCubes[i], glm::vec3(allLights[i+1].position));
+                        scene.setUnlitColor(lightCubes[i], allLights[i+1].color * 3.0f);
+                    }
+                }
             }
 
-            if (allLights.size() > 64) allLights.resize(64);
-            rs.setLights(allLights);
-
-            // Обновляем визуальные кубики для основных лампочек (последние 3 объекта в векторе objects)
-            for(size_t i=0; i<3; ++i) {
-                size_t objIdx = objects.size() - 3 + i;
-                if (objIdx < objects.size() && i + 1 < allLights.size()) { // i+1 так как 0-й свет это солнце
-                    objects[objIdx].transform = glm::translate(glm::mat4(1.0f), glm::vec3(allLights[i+1].position)) * glm::scale(glm::mat4(1.0f), glm::vec3(0.2f));
-                    objects[objIdx].unlitColor = allLights[i+1].color * 3.0f;
+            uint64_t sceneStartNs = CpuProfiler::nowNs();
+            {
+                CPU_ZONE("scene update");
+                scene.updateTransforms();
+            }
+            uint64_t sceneNs = CpuProfiler::nowNs() - sceneStartNs;
+
+            // Пересобранные в фоне шейдеры подменяются между кадрами
+            shaderResults.clear();
+            shaderWatcher.poll(shaderResults);
+            if (!shaderResults.empty()) {
+                CPU_ZONE("shader reload");
+                reloadedShaders.clear();
+                for (const auto& r : shaderResults) {
+                    if (r.ok) {
+                        std::cout << "shader " << r.source << ": compiled in " << r.compileMs << " ms\n";
+                        reloadedShaders.push_back(r.spvPath);
+                    } else {
+                        std::cerr << "shader " << r.source << ": compile failed\n" << r.log;
+                    }
                 }
+                if (!reloadedShaders.empty()) rs.reloadShaders(engine, reloadedShaders);
             }
 
-            std::vector<SceneObject> frameObjects = objects;
-            for (const auto& fl : droppedLights) {
-                frameObjects.push_back(fl.object);
+            FrameContext ctx;
+            uint64_t waitStartNs = CpuProfiler::nowNs();
+            {
+                CPU_ZONE("beginFrame");
+                ctx = engine.beginFrame();
             }
-
-            FrameContext ctx = engine.beginFrame();
+            uint64_t waitNs = CpuProfiler::nowNs() - waitStartNs;
+            // Результаты GPU читаются через framesInFlight кадров — в beginFrame того же слота
+            auto& gpuProfiler = engine.getGpuProfiler();
+            const uint64_t gpuLag = (uint64_t)engine.getFramesInFlight();
+            if (scripted && gpuProfiler.completedFrames() != gpuFramesSeen) {
+                gpuFramesSeen = gpuProfiler.completedFrames();
+                if (benchmark && frameNumber >= benchScript.warmup + gpuLag) benchStats.addGpu(gpuProfiler.lastFrameMs());
+                if (stress && frameNumber >= gpuLag) stressSweep.addGpu(frameNumber - gpuLag, gpuProfiler.lastFrameMs());
+                if (golden && frameNumber >= gpuLag) goldenRunner.addGpu(frameNumber - gpuLag, gpuProfiler.lastFrameMs());
+            }
+            if (benchmark && frameNumber > benchScript.warmup) benchStats.addSubmitToObserved(engine.getSubmitToObserved().lastMs);
             if (!ctx.valid) {
                 engine.recreateSwapchain();
                 rs.onResize(engine);
@@ -254,13 +653,86 @@ int main() {
                 continue;
             }
 
-            rs.recordFrame(ctx.cmd, ctx.imageIndex, ctx.frameIndex, camera, frameObjects, engine);
-            engine.endFrame(ctx);
+            uint64_t allocsBefore = AllocCounter::count();
+            int growsBefore = rs.drawListGrowCount();
+            {
+                CPU_ZONE("recordFrame");
+                rs.recordFrame(ctx.cmd, ctx.imageIndex, ctx.frameIndex, camera, scene, engine);
+            }
+            uint64_t renderAllocs = AllocCounter::count() - allocsBefore;
+            // После прогрева отрисовка не должна трогать кучу, пока список не вырос
+            if (++frameNumber > Engine::MAX_FRAMES && renderAllocs > 0 && rs.drawListGrowCount() == growsBefore && !reportedRenderAllocs) {
+                std::cerr << "Render path allocated " << renderAllocs << " times in steady state (frame " << frameNumber << ")\n";
+                reportedRenderAllocs = true;
+            }
+            if (headless && !golden && frameNumber == frameLimit) engine.requestFrameCapture(headlessOut);
+            const bool goldenCapture = golden && goldenRunner.caseEnds(frameNumber - 1);
+            if (goldenCapture) engine.requestFrameCapture("");
+            {
+                CPU_ZONE("endFrame");
+                engine.endFrame(ctx);
+            }
+            uint64_t frameNs = CpuProfiler::nowNs() - frameStartNs;
+            if (benchmark && frameNumber > benchScript.warmup) {
+                benchStats.addCpu((double)(frameNs - waitNs) * 1e-6, (double)frameNs * 1e-6);
+                benchStats.addVertices(3 * (rs.getFrameStats().triangles + rs.getFrameStats().shadowTriangles));
+            }
+            if (stress) stressSweep.addFrame(frameNumber - 1, (double)(frameNs - waitNs) * 1e-6, (double)sceneNs * 1e-6, rs.getFrameStats());
+            if (golden) goldenRunner.addCpu(frameNumber - 1, (double)(frameNs - waitNs) * 1e-6);
+            frameLimiter.wait();
+            if (goldenCapture) {
+                // Ждём GPU прямо здесь: снимок нужен до смены ракурса
+                uint64_t capturesBefore = engine.getCaptureCount();
+                engine.flushFrameCaptures();
+                goldenRunner.finishCase(frameNumber - 1, engine.getCaptureCount() != capturesBefore ? &engine.getLastCapture() : nullptr);
+            }
         }
 
+    shaderWatcher.stop();
+    if (hasFlag(argc, argv, "--cpu-trace") && CpuProfiler::writeChromeTrace("cpu_trace.json"))
+        std::cout << "cpu trace written to cpu_trace.json\n";
+    engine.getGpuProfiler().report(std::cout);
+    {
+        const auto& lat = engine.getSubmitToObserved();
+        std::cout << "submit to observed completion (polled in beginFrame, " << engine.getFramesInFlight() << " frames in flight): avg "
+                  << lat.avgMs << " ms, max " << lat.maxMs << " ms over last " << std::min<uint64_t>(lat.samples, Engine::OBSERVED_WINDOW) << " frames\n";
+    }
+    if (benchmark) {
+        VkExtent2D extent = engine.getSwapExtent();
+        std::string scriptName = benchScriptPath.empty() ? "default" : benchScriptPath;
+        if (benchStats.writeJson(benchOut, scriptName, engine.getPhysProps().deviceName, extent.width, extent.height, engine.getFramesInFlight()))
+            std::cout << "benchmark results written to " << benchOut << "\n";
+        else
+            std::cerr << "cannot write " << benchOut << "\n";
+    }
+    if (stress) {
+        if (stressReload > 0) {
+            releaseReloadObj();
+            std::cout << "stress reload: " << reloadCount << " reloads of " << reloadPath << "\n";
+        }
+        stressSweep.print(std::cout);
+        const char* layout = stressConfig.layout == StressLayout::Random ? "random" : "grid";
+        if (stressSweep.writeCsv(stressOut, layout)) std::cout << "stress results written to " << stressOut << "\n";
+        else std::cerr << "cannot write " << stressOut << "\n";
+    }
+    int exitCode = 0;
+    if (golden) {
+        goldenRunner.print(std::cout);
+        const std::string report = flagValue(argc, argv, "--golden-report", "golden_report.json");
+        if (!goldenRunner.writeReport(report)) std::cerr << "cannot write " << report << "\n";
+        if (goldenRunner.referencesMissing()) {
+            std::cout << "golden: no reference images, skipped (run the update-golden target)\n";
+            exitCode = GOLDEN_SKIP_CODE;
+        } else if (!goldenRunner.passed()) {
+            exitCode = 1;
+        }
+    }
+    engine.flushFrameCaptures();
     rs.cleanup(engine);
     engine.cleanup();
-    glfwDestroyWindow(window);
-    glfwTerminate();
-    return 0;
+    if (window) {
+        glfwDestroyWindow(window);
+        glfwTerminate();
+    }
+    return exitCode;
 }
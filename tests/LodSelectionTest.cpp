@@ -0,0 +1,53 @@
+#include "LodSelection.h"
+#include "TestCheck.h"
+#include <glm/gtc/matrix_transform.hpp>
+
+// Как Camera::projection: Y перевёрнут, proj[1][1] < 0
+static glm::mat4 cameraProjection() {
+    auto p = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 1000.0f);
+    p[1][1] *= -1;
+    return p;
+}
+
+// Ошибка LOD растёт вчетверо на уровень, у LOD0 её нет
+static const MeshLod LODS[Engine::MAX_LODS] = {
+    {0, 0, 0.0f}, {0, 0, 0.001f}, {0, 0, 0.004f}, {0, 0, 0.016f}};
+
+static void testDistance() {
+    float scale = LodSelection::pixelScale(cameraProjection(), 1080);
+    CHECK(scale > 0.0f);
+
+    // В полуметре от камеры даже LOD1 заметен, вдали хватает самого грубого
+    CHECK(LodSelection::select(LODS, Engine::MAX_LODS, scale / 0.5f, 0xFF) == 0);
+    CHECK(LodSelection::select(LODS, Engine::MAX_LODS, scale / 500.0f, 0) == Engine::MAX_LODS - 1);
+    // Без предыдущего выбора берётся идеальный LOD
+    CHECK(LodSelection::select(LODS, Engine::MAX_LODS, scale / 500.0f, 0xFF) == Engine::MAX_LODS - 1);
+    // Один LOD — выбирать нечего
+    CHECK(LodSelection::select(LODS, 1, scale / 500.0f, 0) == 0);
+}
+
+static void testHysteresis() {
+    // Ошибка LOD1 ровно на пороге: идеален LOD1, но грубее не переходим,
+    // пока ошибка не упадёт ниже COARSEN_FACTOR
+    float atThreshold = LodSelection::ERROR_PIXELS / LODS[1].error;
+    CHECK(LodSelection::select(LODS, Engine::MAX_LODS, atThreshold, 0xFF) == 1);
+    CHECK(LodSelection::select(LODS, Engine::MAX_LODS, atThreshold, 0) == 0);
+    CHECK(LodSelection::select(LODS, Engine::MAX_LODS, atThreshold * 0.7f, 0) == 1);
+
+    // Внутри полосы текущий LOD держится, за REFINE_FACTOR — уточняется
+    CHECK(LodSelection::select(LODS, Engine::MAX_LODS, atThreshold * 1.2f, 1) == 1);
+    CHECK(LodSelection::select(LODS, Engine::MAX_LODS, atThreshold * 1.3f, 1) == 0);
+
+    // Идемпотентность: повторный вызов с результатом не меняет LOD
+    for (float ppu : {atThreshold * 0.5f, atThreshold, atThreshold * 3.0f, atThreshold * 20.0f})
+        for (uint8_t prev = 0; prev < Engine::MAX_LODS; ++prev) {
+            uint8_t lod = LodSelection::select(LODS, Engine::MAX_LODS, ppu, prev);
+            CHECK(LodSelection::select(LODS, Engine::MAX_LODS, ppu, lod) == lod);
+        }
+}
+
+int main() {
+    testDistance();
+    testHysteresis();
+    return testResult("LodSelectionTest");
+}
@@ -0,0 +1,204 @@
+#include "MeshOptimizer.h"
+#include "TestCheck.h"
+#include <algorithm>
+#include <array>
+#include <random>
+#include <set>
+
+using Triangle = std::array<glm::vec3, 3>;
+
+// Плоская сетка n x n квадов в плоскости XZ: открытый меш с границей
+static void makeGrid(uint32_t n, std::vector<Vertex>& verts, std::vector<uint32_t>& indices) {
+    verts.clear();
+    indices.clear();
+    for (uint32_t z = 0; z <= n; ++z)
+        for (uint32_t x = 0; x <= n; ++x)
+            verts.push_back({{(float)x, 0.0f, (float)z}, {0, 1, 0}, {(float)x / n, (float)z / n}});
+    for (uint32_t z = 0; z < n; ++z)
+        for (uint32_t x = 0; x < n; ++x) {
+            uint32_t i = z * (n + 1) + x;
+            indices.insert(indices.end(), {i, i + n + 1, i + 1, i + 1, i + n + 1, i + n + 2});
+        }
+}
+
+// Куб со сторонами из n x n квадов и общими вершинами на рёбрах: замкнутый меш
+static void makeCube(uint32_t n, std::vector<Vertex>& verts, std::vector<uint32_t>& indices) {
+    verts.clear();
+    indices.clear();
+    auto vertexAt = [&](const glm::vec3& p) {
+        for (uint32_t i = 0; i < (uint32_t)verts.size(); ++i)
+            if (verts[i].pos == p) return i;
+        verts.push_back({p, glm::vec3(0.0f), glm::vec2(0.0f)});
+        return (uint32_t)verts.size() - 1;
+    };
+    const glm::vec3 axes[3] = {{1, 0, 0}, {0, 1, 0}, {0, 0, 1}};
+    for (int a = 0; a < 3; ++a)
+        for (float side : {-1.0f, 1.0f}) {
+            glm::vec3 nrm = axes[a] * side;
+            glm::vec3 u = axes[(a + 1) % 3], v = axes[(a + 2) % 3];
+            if (side < 0.0f) std::swap(u, v); // наружу смотрит против часовой
+            for (uint32_t j = 0; j < n; ++j)
+                for (uint32_t i = 0; i < n; ++i) {
+                    auto at = [&](uint32_t ii, uint32_t jj) {
+                        return vertexAt(nrm + u * (2.0f * ii / n - 1.0f) + v * (2.0f * jj / n - 1.0f));
+                    };
+                    uint32_t p00 = at(i, j), p10 = at(i + 1, j), p01 = at(i, j + 1), p11 = at(i + 1, j + 1);
+                    indices.insert(indices.end(), {p00, p10, p11, p00, p11, p01});
+                }
+        }
+}
+
+// Треугольник с точностью до циклического сдвига вершин
+static Triangle canonical(const Triangle& t) {
+    auto less = [](const glm::vec3& a, const glm::vec3& b) {
+        return a.x != b.x ? a.x < b.x : a.y != b.y ? a.y < b.y : a.z < b.z;
+    };
+    int m = 0;
+    for (int k = 1; k < 3; ++k)
+        if (less(t[k], t[m])) m = k;
+    return {t[m], t[(m + 1) % 3], t[(m + 2) % 3]};
+}
+
+static std::vector<Triangle> triangles(const std::vector<Vertex>& verts, const std::vector<uint32_t>& indices, size_t first = 0, size_t count = SIZE_MAX) {
+    count = std::min(count, indices.size() - first);
+    std::vector<Triangle> out;
+    for (size_t t = first; t < first + count; t += 3)
+        out.push_back(canonical({verts[indices[t]].pos, verts[indices[t + 1]].pos, verts[indices[t + 2]].pos}));
+    auto less = [](const Triangle& a, const Triangle& b) {
+        for (int k = 0; k < 3; ++k) {
+            if (a[k].x != b[k].x) return a[k].x < b[k].x;
+            if (a[k].y != b[k].y) return a[k].y < b[k].y;
+            if (a[k].z != b[k].z) return a[k].z < b[k].z;
+        }
+        return false;
+    };
+    std::sort(out.begin(), out.end(), less);
+    return out;
+}
+
+static void testVertexCacheAndFetch() {
+    std::vector<Vertex> verts;
+    std::vector<uint32_t> indices;
+    makeGrid(32, verts, indices);
+    // Перемешанные треугольники — худший порядок для кэша
+    std::mt19937 rng(7);
+    std::vector<uint32_t> order(indices.size() / 3);
+    for (uint32_t i = 0; i < (uint32_t)order.size(); ++i) order[i] = i;
+    std::shuffle(order.begin(), order.end(), rng);
+    std::vector<uint32_t> shuffled;
+    for (uint32_t t : order) shuffled.insert(shuffled.end(), {indices[3 * t], indices[3 * t + 1], indices[3 * t + 2]});
+    indices = shuffled;
+    std::vector<Triangle> before = triangles(verts, indices);
+    float acmrBefore = MeshOptimizer::analyzeVertexCache(indices, verts.size()).acmr;
+
+    MeshOptimizer::optimizeVertexCache(indices, verts.size());
+    CHECK(triangles(verts, indices) == before);
+    float acmrAfter = MeshOptimizer::analyzeVertexCache(indices, verts.size()).acmr;
+    CHECK(acmrAfter < acmrBefore);
+    CHECK(acmrAfter < 1.0f);
+
+    MeshOptimizer::optimizeOverdraw(indices, verts);
+    CHECK(triangles(verts, indices) == before);
+
+    // Лишняя вершина, на которую никто не ссылается, выкидывается
+    verts.push_back({{-5, -5, -5}, {0, 1, 0}, {0, 0}});
+    size_t used = verts.size() - 1;
+    MeshOptimizer::optimizeVertexFetch(verts, indices);
+    CHECK(verts.size() == used);
+    CHECK(triangles(verts, indices) == before);
+    // Вершины идут в порядке первого использования
+    uint32_t next = 0;
+    bool firstUseOrder = true;
+    for (uint32_t i : indices) {
+        if (i > next) firstUseOrder = false;
+        if (i == next) ++next;
+    }
+    CHECK(firstUseOrder);
+}
+
+static void testSimplify() {
+    std::vector<Vertex> verts;
+    std::vector<uint32_t> indices;
+    makeCube(8, verts, indices);
+    std::vector<uint32_t> out;
+    size_t target = indices.size() / 2 / 3 * 3;
+    float error = MeshOptimizer::simplify(indices, verts, target, out);
+    CHECK(out.size() % 3 == 0);
+    CHECK(out.size() <= target);
+    CHECK(error >= 0.0f);
+    // Грани куба плоские, а углы закреплены: ошибка остаётся почти нулевой
+    CHECK(error < 1e-3f);
+    bool valid = true, degenerate = false;
+    for (size_t t = 0; t < out.size(); t += 3) {
+        for (int k = 0; k < 3; ++k) valid = valid && out[t + k] < verts.size();
+        degenerate = degenerate || out[t] == out[t + 1] || out[t + 1] == out[t + 2] || out[t] == out[t + 2];
+    }
+    CHECK(valid);
+    CHECK(!degenerate);
+
+    // Граница открытой сетки не двигается
+    makeGrid(16, verts, indices);
+    error = MeshOptimizer::simplify(indices, verts, indices.size() / 4 / 3 * 3, out);
+    std::set<uint32_t> referenced(out.begin(), out.end());
+    for (uint32_t i = 0; i <= 16; ++i) {
+        CHECK(referenced.count(i));
+        CHECK(referenced.count(16 * 17 + i));
+    }
+    CHECK(error < 1e-3f);
+
+    std::vector<MeshLod> lods;
+    makeCube(16, verts, indices);
+    size_t baseCount = indices.size();
+    MeshOptimizer::generateLods(verts, indices, lods);
+    CHECK(lods.size() >= 2);
+    CHECK(lods[0].firstIndex == 0 && lods[0].indexCount == baseCount);
+    for (size_t l = 1; l < lods.size(); ++l) {
+        CHECK(lods[l].firstIndex == lods[l - 1].firstIndex + lods[l - 1].indexCount);
+        CHECK(lods[l].indexCount < lods[l - 1].indexCount);
+        CHECK(lods[l].error >= lods[l - 1].error);
+    }
+    CHECK(lods.back().firstIndex + lods.back().indexCount == indices.size());
+}
+
+static void checkMeshlets(const std::vector<Vertex>& verts, const std::vector<uint32_t>& indices, const std::vector<Meshlet>& meshlets) {
+    // Кластеры подряд покрывают весь поток и укладываются в лимиты
+    uint32_t expected = 0;
+    for (const Meshlet& m : meshlets) {
+        CHECK(m.firstIndex == expected);
+        CHECK(m.indexCount % 3 == 0 && m.indexCount > 0);
+        CHECK(m.indexCount / 3 <= MeshOptimizer::MESHLET_MAX_TRIANGLES);
+        std::set<uint32_t> unique(indices.begin() + m.firstIndex, indices.begin() + m.firstIndex + m.indexCount);
+        CHECK(unique.size() <= MeshOptimizer::MESHLET_MAX_VERTICES);
+        for (uint32_t v : unique) CHECK(glm::length(verts[v].pos - glm::vec3(m.sphere)) <= m.sphere.w + 1e-4f);
+        expected += m.indexCount;
+    }
+    CHECK(expected == indices.size());
+}
+
+static void testMeshlets() {
+    std::vector<Vertex> verts;
+    std::vector<uint32_t> indices;
+    std::vector<Meshlet> meshlets;
+
+    // Открытая сетка: задняя сторона видна, конус не должен отсекать
+    makeGrid(32, verts, indices);
+    MeshOptimizer::optimizeVertexCache(indices, verts.size());
+    MeshOptimizer::buildMeshlets(verts, indices, indices.size(), meshlets);
+    CHECK(meshlets.size() > 1);
+    checkMeshlets(verts, indices, meshlets);
+    CHECK(std::all_of(meshlets.begin(), meshlets.end(), [](const Meshlet& m) { return m.cone.w == 1.0f; }));
+
+    // Замкнутый куб: кластеры внутри одной грани получают рабочий конус
+    makeCube(16, verts, indices);
+    MeshOptimizer::optimizeVertexCache(indices, verts.size());
+    MeshOptimizer::buildMeshlets(verts, indices, indices.size(), meshlets);
+    checkMeshlets(verts, indices, meshlets);
+    CHECK(std::any_of(meshlets.begin(), meshlets.end(), [](const Meshlet& m) { return m.cone.w < 1.0f; }));
+}
+
+int main() {
+    testVertexCacheAndFetch();
+    testSimplify();
+    testMeshlets();
+    return testResult("MeshOptimizerTest");
+}
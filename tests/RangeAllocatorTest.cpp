@@ -0,0 +1,74 @@
+#include "RangeAllocator.h"
+#include "TestCheck.h"
+#include <random>
+
+static void testReuse() {
+    RangeAllocator a;
+    uint32_t x = a.allocate(10), y = a.allocate(20), z = a.allocate(30);
+    CHECK(x == 0 && y == 10 && z == 30);
+    CHECK(a.size() == 60);
+
+    // Освобождение не сдвигает соседей, дыра отдаётся первому подходящему
+    a.release(y, 20);
+    CHECK(a.freeCount() == 20);
+    CHECK(a.allocate(25) == 60);
+    CHECK(a.allocate(15) == 10);
+    CHECK(a.allocate(5) == 25);
+    CHECK(a.freeCount() == 0);
+    CHECK(a.size() == 85);
+}
+
+static void testMerge() {
+    RangeAllocator a;
+    uint32_t r[4];
+    for (uint32_t& o : r) o = a.allocate(8);
+    // Соседние свободные диапазоны сливаются в любом порядке освобождения
+    a.release(r[0], 8);
+    a.release(r[2], 8);
+    a.release(r[1], 8);
+    CHECK(a.allocate(24) == 0);
+    CHECK(a.size() == 32);
+
+    // Свободный хвост дорастает до запроса, а не оставляет дыру
+    a.release(r[3], 8);
+    CHECK(a.allocate(12) == 24);
+    CHECK(a.size() == 36);
+    CHECK(a.freeCount() == 0);
+}
+
+// Случайные выделения и освобождения против карты занятости
+static void testRandom() {
+    RangeAllocator a;
+    std::mt19937 rng(7);
+    std::vector<std::pair<uint32_t, uint32_t>> live;
+    std::vector<int> owner;
+    for (int step = 0; step < 2000; ++step) {
+        if (live.empty() || rng() % 3 != 0) {
+            uint32_t count = 1 + rng() % 64;
+            uint32_t offset = a.allocate(count);
+            if (owner.size() < a.size()) owner.resize(a.size(), -1);
+            for (uint32_t i = offset; i < offset + count; ++i) {
+                CHECK(owner[i] == -1);
+                owner[i] = step;
+            }
+            live.push_back({offset, count});
+        } else {
+            size_t k = rng() % live.size();
+            for (uint32_t i = live[k].first; i < live[k].first + live[k].second; ++i) owner[i] = -1;
+            a.release(live[k].first, live[k].second);
+            live[k] = live.back();
+            live.pop_back();
+        }
+        CHECK(a.size() == owner.size());
+        uint32_t used = 0;
+        for (const auto& r : live) used += r.second;
+        CHECK(used + a.freeCount() == a.size());
+    }
+}
+
+int main() {
+    testReuse();
+    testMerge();
+    testRandom();
+    return testResult("RangeAllocatorTest");
+}
@@ -0,0 +1,152 @@
+#include "Scene.h"
+#include "TestCheck.h"
+#include <cmath>
+
+// Родитель всегда раньше ребёнка — на этом держится однопроходный updateTransforms
+static bool topological(const Scene& scene) {
+    const auto& parents = scene.getParents();
+    for (uint32_t i = 0; i < (uint32_t)parents.size(); ++i)
+        if (parents[i] != Scene::NO_PARENT && parents[i] >= i) return false;
+    return true;
+}
+
+static bool near(const glm::vec3& a, const glm::vec3& b) {
+    return std::abs(a.x - b.x) < 1e-5f && std::abs(a.y - b.y) < 1e-5f && std::abs(a.z - b.z) < 1e-5f;
+}
+
+static glm::vec3 worldPos(const Scene& scene, SceneHandle h) {
+    return glm::vec3(scene.getWorld(h)[3]);
+}
+
+static SceneObject objectAt(const glm::vec3& p, int meshId = -1) {
+    SceneObject obj;
+    obj.position = p;
+    if (meshId >= 0) {
+        SubMesh sm;
+        sm.mesh.id = meshId;
+        obj.submeshes.push_back(sm);
+    }
+    return obj;
+}
+
+static void testReparent(const Engine& engine) {
+    Scene scene;
+    SceneHandle a = scene.add(objectAt({1, 0, 0}), engine);
+    SceneHandle b = scene.add(objectAt({0, 5, 0}), engine);
+    SceneHandle c = scene.add(objectAt({0, 0, 2}), engine, a);
+    SceneHandle d = scene.add(objectAt({0, 0, 3}), engine, c);
+
+    // Новый родитель правее: поддерево a переезжает в конец целиком
+    scene.setParent(a, b);
+    CHECK(topological(scene));
+    scene.updateTransforms();
+    CHECK(near(worldPos(scene, a), {1, 5, 0}));
+    CHECK(near(worldPos(scene, c), {1, 5, 2}));
+    CHECK(near(worldPos(scene, d), {1, 5, 5}));
+
+    // Цикл (b под собственного потомка) отклоняется без изменений
+    std::vector<uint32_t> before = scene.getParents();
+    scene.setParent(b, d);
+    CHECK(scene.getParents() == before);
+    scene.setParent(b, b);
+    CHECK(scene.getParents() == before);
+
+    // Отцепление возвращает локальную позицию как мировую
+    scene.setParent(c, {});
+    CHECK(topological(scene));
+    scene.updateTransforms();
+    CHECK(near(worldPos(scene, c), {0, 0, 2}));
+    CHECK(near(worldPos(scene, d), {0, 0, 5}));
+
+    // Движение родителя доходит до детей без явной пометки детей
+    scene.setLocalPosition(c, {0, 1, 0});
+    scene.updateTransforms();
+    CHECK(near(worldPos(scene, d), {0, 1, 3}));
+}
+
+static void testRemove(const Engine& engine) {
+    Scene scene;
+    SceneHandle root = scene.add(objectAt({0, 0, 0}), engine);
+    SceneHandle keep = scene.add(objectAt({7, 0, 0}), engine);
+    SceneHandle child = scene.add(objectAt({1, 0, 0}), engine, root);
+    SceneHandle grandChild = scene.add(objectAt({1, 0, 0}), engine, child);
+    SceneHandle keepChild = scene.add(objectAt({0, 1, 0}), engine, keep);
+
+    scene.remove(root);
+    CHECK(scene.size() == 2);
+    CHECK(!scene.alive(root) && !scene.alive(child) && !scene.alive(grandChild));
+    CHECK(scene.alive(keep) && scene.alive(keepChild));
+    CHECK(topological(scene));
+    scene.updateTransforms();
+    CHECK(near(worldPos(scene, keepChild), {7, 1, 0}));
+
+    // Слот переиспользуется, но старый хэндл остаётся мёртвым и ничего не пишет
+    SceneHandle reused = scene.add(objectAt({0, 0, 9}), engine);
+    CHECK(reused.slot == grandChild.slot || reused.slot == child.slot || reused.slot == root.slot);
+    CHECK(!scene.alive(root) && !scene.alive(child) && !scene.alive(grandChild));
+    scene.setLocalPosition(root, {100, 100, 100});
+    scene.setLocalPosition(child, {100, 100, 100});
+    scene.setLocalPosition(grandChild, {100, 100, 100});
+    scene.setParent(root, keep);
+    scene.nextAnimFrame(child);
+    scene.updateTransforms();
+    CHECK(near(worldPos(scene, reused), {0, 0, 9}));
+    CHECK(near(worldPos(scene, keep), {7, 0, 0}));
+    CHECK(scene.size() == 3);
+
+    // Повторное удаление и удаление пустого хэндла — no-op
+    scene.remove(root);
+    scene.remove({});
+    CHECK(scene.size() == 3);
+}
+
+static void testSubMeshCompaction(const Engine& engine) {
+    Scene scene;
+    std::vector<SceneHandle> handles;
+    for (int i = 0; i < 10; ++i) handles.push_back(scene.add(objectAt({(float)i, 0, 0}, i), engine));
+    // Больше половины сабмешей мертвы — общий массив пересобирается
+    for (int i = 0; i < 10; i += 2) scene.remove(handles[i]);
+    scene.remove(handles[1]);
+    CHECK(scene.size() == 4);
+    CHECK(scene.getSubMeshes().size() == 4);
+
+    // Диапазоны живых объектов указывают на их собственные меши
+    const auto& ranges = scene.getRanges();
+    const auto& subMeshes = scene.getSubMeshes();
+    std::vector<int> meshIds;
+    for (const auto& r : ranges) {
+        CHECK(r.count == 1);
+        CHECK(r.first + r.count <= subMeshes.size());
+        meshIds.push_back(subMeshes[r.first].mesh.id);
+    }
+    CHECK((meshIds == std::vector<int>{3, 5, 7, 9}));
+    scene.updateTransforms();
+    CHECK(near(worldPos(scene, handles[7]), {7, 0, 0}));
+}
+
+static void testNormalMatrix(const Engine& engine) {
+    Scene scene;
+    SceneObject parent = objectAt({0, 0, 0});
+    parent.scale = glm::vec3(2.0f, 1.0f, 1.0f);
+    SceneHandle p = scene.add(parent, engine);
+    SceneHandle u = scene.add(objectAt({0, 0, 0}), engine);
+    SceneHandle c = scene.add(objectAt({0, 0, 0}), engine, p);
+    scene.updateTransforms();
+    // Неравномерный масштаб родителя делает неравномерным и ребёнка
+    const auto& flags = scene.getFlags();
+    const auto& normals = scene.getNormalMatrices();
+    CHECK(flags[1] & SCENE_UNIFORM);
+    CHECK(!(flags[0] & SCENE_UNIFORM));
+    CHECK(!(flags[2] & SCENE_UNIFORM));
+    CHECK(std::abs(normals[2][0][0] - 0.5f) < 1e-5f);
+    (void)u; (void)c;
+}
+
+int main() {
+    Engine engine;
+    testReparent(engine);
+    testRemove(engine);
+    testSubMeshCompaction(engine);
+    testNormalMatrix(engine);
+    return testResult("SceneTest");
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <iostream>
+
+// Минимальные проверки для CPU-тестов: без фреймворка, код возврата 1 при
+// любой неудаче, ctest показывает вывод упавших проверок
+inline int& testFailures() {
+    static int failures = 0;
+    return failures;
+}
+
+#define CHECK(cond)                                                                  \
+    do {                                                                             \
+        if (!(cond)) {                                                               \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #cond ") failed\n"; \
+            ++testFailures();                                                        \
+        }                                                                            \
+    } while (0)
+
+inline int testResult(const char* name) {
+    if (testFailures() == 0) std::cout << name << ": ok\n";
+    else std::cerr << name << ": " << testFailures() << " check(s) failed\n";
+    return testFailures() == 0 ? 0 : 1;
+}